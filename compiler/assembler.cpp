@@ -49,6 +49,7 @@
 #include "sctracker.h"
 #include "symbols.h"
 #include "types.h"
+#include "vm/image-verifier.h"
 
 using namespace SourcePawn;
 using namespace ke;
@@ -850,7 +851,7 @@ Assembler::Assemble(SmxByteBuffer* buffer)
 
             functions.emplace_back(std::move(entry));
         } else if (auto var = decl->as<VarDecl>()) {
-            if (var->is_public() || (var->is_used() && !var->as<ConstDecl>())) {
+            if (var->is_public() || (var->is_live() && var->is_used() && !var->as<ConstDecl>())) {
                 sp_file_pubvars_t& pubvar = pubvars->add();
                 pubvar.address = var->addr();
                 pubvar.name = names->add(var->name());
@@ -912,7 +913,12 @@ Assembler::Assemble(SmxByteBuffer* buffer)
     data->header().datasize = cg_.data_size();
     data->header().memsize = cg_.data_size() + cg_.DynamicMemorySize();
     data->header().data = sizeof(sp_file_data_t);
-    data->setBlob(cg_.data_ptr(), cg_.data_size());
+
+    // Trailing zeroes (usually large uninitialized global arrays) are not
+    // stored; the VM zero-fills them at load time.
+    data->setBlob(cg_.data_ptr(), cg_.data_initialized_size());
+    if (cg_.data_initialized_size() < cg_.data_size())
+        code->header().features |= SmxConsts::kCodeFeatureZeroFilledData;
 
     // Add tables in the same order SourceMod 1.6 added them.
     builder.add(code);
@@ -935,25 +941,17 @@ FailedValidation(const std::string& message)
     exit(1);
 }
 
+// This checks the same things as loading the binary into a VM and calling
+// PerformFullValidation(), but without setting up an environment or a plugin
+// context, so it's cheap enough to run on every compile.
 static void
-VerifyBinary(const char* file, void* buffer, size_t size)
+VerifyBinary(CompileContext& cc, void* buffer, size_t size)
 {
-    std::unique_ptr<ISourcePawnEnvironment> env(ISourcePawnEnvironment::New());
-    if (!env)
-        FailedValidation("could not initialize environment");
-
-    auto api = env->APIv2();
-
-    char msgbuf[255];
-    std::unique_ptr<IPluginRuntime> rt(api->LoadBinaryFromMemory(file, (uint8_t*)buffer, size,
-                                                                 nullptr, msgbuf,  sizeof(msgbuf)));
-    if (!rt)
-        FailedValidation(msgbuf);
-
-    ExceptionHandler eh(api);
-    if (!rt->PerformFullValidation()) {
-        const char* message = eh.HasException() ? eh.Message() : "unknown error";
-        FailedValidation(message);
+    std::string error;
+    if (!VerifyImage(reinterpret_cast<const uint8_t*>(buffer), size,
+                     cc.options()->verify_threads, &error))
+    {
+        FailedValidation(error);
     }
 }
 
@@ -961,7 +959,7 @@ static bool
 splat_to_binary(CompileContext& cc, const char* binfname, void* bytes, size_t size)
 {
     if (cc.verify_output())
-        VerifyBinary(binfname, bytes, size);
+        VerifyBinary(cc, bytes, size);
 
     // Note: error 161 will setjmp(), which skips destructors :(
     FILE* fp = fopen(binfname, "wb");
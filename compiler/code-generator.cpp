@@ -45,6 +45,7 @@ CodeGenerator::CodeGenerator(CompileContext& cc, ParseTree* tree)
   : cc_(cc),
     tree_(tree)
 {
+    asm_.set_fuse(cc_.options()->fuse_instructions);
 }
 
 bool CodeGenerator::Generate() {
@@ -55,6 +56,8 @@ bool CodeGenerator::Generate() {
     if (!ComputeStackUsage())
         return false;
 
+    PlaceZeroFilledData();
+
     // Finish any un-added debug symbols.
     while (!static_syms_.empty()) {
         auto pair = ke::PopBack(&static_syms_);
@@ -69,6 +72,8 @@ bool CodeGenerator::Generate() {
 void
 CodeGenerator::AddDebugFile(const std::string& file)
 {
+    // Debug positions must always land on an instruction boundary.
+    __ fence();
     auto str = ke::StringPrintf("F:%x %s", asm_.position(), file.c_str());
     debug_strings_.emplace_back(str.c_str(), str.size());
 }
@@ -76,6 +81,7 @@ CodeGenerator::AddDebugFile(const std::string& file)
 void
 CodeGenerator::AddDebugLine(int linenr)
 {
+    __ fence();
     auto str = ke::StringPrintf("L:%x %x", asm_.position(), linenr);
     if (fun_) {
         auto data = fun_->cg();
@@ -88,6 +94,17 @@ CodeGenerator::AddDebugLine(int linenr)
 }
 
 void CodeGenerator::AddDebugSymbol(Decl* decl, uint32_t pc) {
+    // The address of a zero-filled global is not final until all other data
+    // has been emitted.
+    auto var = decl->as<VarDeclBase>();
+    if (var && var->is_zero_filled() && !zero_filled_placed_) {
+        zero_filled_syms_.push_back({decl, pc, asm_.position(), fun_});
+        return;
+    }
+    AddDebugSymbol(decl, pc, asm_.position(), fun_);
+}
+
+void CodeGenerator::AddDebugSymbol(Decl* decl, uint32_t pc, uint32_t end_pc, FunctionDecl* owner) {
     auto symname = decl->name()->chars();
     
     std::optional<cell> addr;
@@ -103,7 +120,7 @@ void CodeGenerator::AddDebugSymbol(Decl* decl, uint32_t pc) {
     /* address tag:name codestart codeend ident vclass [tag:dim ...] */
     auto string = ke::StringPrintf("S:%llx %x:%s %x %x %x %x %x", // that %llx, we don't talk about it
                                    *addr, decl->type()->type_index(), symname, pc,
-                                   asm_.position(), decl->ident(), decl->vclass(), (int)decl->is_const());
+                                   end_pc, decl->ident(), decl->vclass(), (int)decl->is_const());
     if (decl->ident() == iARRAY || decl->ident() == iREFARRAY) {
         string += " [ ";
         for (int i = 0; i < decl->dim_count(); i++)
@@ -111,8 +128,8 @@ void CodeGenerator::AddDebugSymbol(Decl* decl, uint32_t pc) {
         string += "]";
     }
 
-    if (fun_) {
-        auto data = fun_->cg();
+    if (owner) {
+        auto data = owner->cg();
         if (!data->dbgstrs)
             data->dbgstrs = cc_.NewDebugStringList();
         data->dbgstrs->emplace_back(string.c_str(), string.size());
@@ -155,10 +172,13 @@ CodeGenerator::EmitStmt(Stmt* stmt)
         case StmtKind::ArgDecl:
             EmitVarDecl(stmt->to<VarDeclBase>());
             break;
-        case StmtKind::ExprStmt:
+        case StmtKind::ExprStmt: {
             // Emit even if no side effects.
-            EmitExpr(stmt->to<ExprStmt>()->expr());
+            auto expr = stmt->to<ExprStmt>()->expr();
+            if (!EmitConstStoreStmt(expr))
+                EmitExpr(expr);
             break;
+        }
         case StmtKind::ExitStmt: {
             auto e = stmt->to<ExitStmt>();
             if (e->expr())
@@ -276,6 +296,11 @@ CodeGenerator::EmitChangeScopeNode(ChangeScopeNode* node)
 }
 
 void CodeGenerator::EmitVarDecl(VarDeclBase* decl) {
+    if (!fun_ && IsDeadGlobal(decl)) {
+        DropGlobalVar(decl);
+        return;
+    }
+
     if (decl->type()->isPstruct()) {
         EmitPstruct(decl);
     } else {
@@ -294,18 +319,48 @@ void CodeGenerator::EmitVarDecl(VarDeclBase* decl) {
 void CodeGenerator::EmitGlobalVar(VarDeclBase* decl) {
     BinaryExpr* init = decl->init();
 
-    __ bind_to(decl->label(), data_.dat_address());
-
     if (decl->ident() == iVARIABLE) {
         assert(!init || init->right()->val().ident == iCONSTEXPR);
-        if (init)
-            data_.Add(init->right()->val().constval());
-        else
-            data_.Add(0);
+        cell value = init ? init->right()->val().constval() : 0;
+        if (!value) {
+            AddZeroFilledVar(decl, sizeof(cell));
+            return;
+        }
+        __ bind_to(decl->label(), data_.dat_address());
+        data_.Add(value);
     } else if (decl->ident() == iARRAY) {
         ArrayData array;
-        BuildArrayInitializer(decl, &array, data_.dat_address());
+        BuildArrayInitializer(decl->type_info(), decl->init_rhs(), &array);
+
+        // Nothing but zeroes: no storage in the image at all. A multi-dimensional
+        // array still needs its indirection vectors, but they can point into the
+        // zero-filled region.
+        if (array.data.empty()) {
+            cell bytes = array.zeroes * sizeof(cell);
+            if (array.iv.empty()) {
+                AddZeroFilledVar(decl, bytes);
+                return;
+            }
+
+            cell iv_addr = data_.dat_address();
+            cell iv_bytes = (cell)(array.iv.size() * sizeof(cell));
+            cell offset = data_.AddZeroFilled(bytes);
 
+            __ bind_to(decl->label(), iv_addr);
+            for (const auto& v : array.iv) {
+                if (v >= iv_bytes)
+                    data_.AddZeroFilledAddress(offset + v - iv_bytes);
+                else
+                    data_.Add(iv_addr + v);
+            }
+            return;
+        }
+
+        cell base = data_.dat_address();
+        for (auto& v : array.iv)
+            v += base;
+
+        __ bind_to(decl->label(), base);
         data_.Add(std::move(array.iv));
         data_.Add(std::move(array.data));
         data_.AddZeroes(array.zeroes);
@@ -314,6 +369,44 @@ void CodeGenerator::EmitGlobalVar(VarDeclBase* decl) {
     }
 }
 
+void CodeGenerator::AddZeroFilledVar(VarDeclBase* decl, cell bytes) {
+    decl->BindZeroFilledAddress(data_.AddZeroFilled(bytes));
+    zero_filled_vars_.emplace_back(decl);
+}
+
+void CodeGenerator::PlaceZeroFilledData() {
+    cell base = data_.PlaceZeroFilled();
+    __ relocate_zero_filled(base);
+    for (const auto& decl : zero_filled_vars_)
+        decl->RelocateZeroFilled(base);
+    zero_filled_placed_ = true;
+
+    for (const auto& sym : zero_filled_syms_)
+        AddDebugSymbol(sym.decl, sym.pc, sym.end_pc, sym.owner);
+    zero_filled_syms_.clear();
+}
+
+bool CodeGenerator::IsDeadGlobal(VarDeclBase* decl) {
+    if (decl->vclass() == sLOCAL || decl->ident() == iCONSTEXPR)
+        return false;
+    if (decl->type()->isPstruct())
+        return false;
+    return !decl->is_public() && !decl->is_live();
+}
+
+void CodeGenerator::DropGlobalVar(VarDeclBase* decl) {
+    // Nothing live refers to this global, so it gets no storage and no debug
+    // symbol. Only the would-be size is needed for --show-stats.
+    cell_t size = 1;
+    if (decl->ident() == iARRAY) {
+        ArrayData array;
+        BuildArrayInitializer(decl, &array, 0);
+        size = (cell_t)array.total_size();
+    }
+    dead_globals_++;
+    dead_global_bytes_ += size * sizeof(cell);
+}
+
 void
 CodeGenerator::EmitLocalVar(VarDeclBase* decl)
 {
@@ -374,16 +467,19 @@ CodeGenerator::EmitLocalVar(VarDeclBase* decl)
             }
         }
 
-        cell iv_addr = data_.dat_address();
-        data_.Add(std::move(array.iv));
-        data_.Add(std::move(array.data));
+        // INITARRAY only ever reads its source, so identical initializers
+        // can share one copy in the data section.
+        tr::vector<cell> run = std::move(array.iv);
+        run.insert(run.end(), array.data.begin(), array.data.end());
         if (array.zeroes < 16) {
             // For small numbers of extra zeroes, fold them into the data
             // section.
-            data_.AddZeroes(array.zeroes);
+            run.resize(run.size() + array.zeroes, 0);
             array.zeroes = 0;
         }
 
+        cell iv_addr = run.empty() ? data_.dat_address() : data_.Intern(std::move(run));
+
         if (array.zeroes) {
             assert(fill_value == 0);
             fill_size = array.zeroes;
@@ -411,11 +507,9 @@ CodeGenerator::EmitLocalVar(VarDeclBase* decl)
         if (NewArrayExpr* ctor = init_rhs->as<NewArrayExpr>()) {
             EmitExpr(ctor);
         } else if (StringExpr* ctor = init_rhs->as<StringExpr>()) {
-            auto queue_size = data_.size();
-            auto str_addr = data_.dat_address();
-            data_.Add(ctor->text()->chars(), ctor->text()->length());
+            auto str_addr = data_.Intern(ctor->text()->chars(), ctor->text()->length());
 
-            auto cells = data_.size() - queue_size;
+            auto cells = char_array_cells(ctor->text()->length() + 1) * sizeof(cell);
             assert(cells > 0);
 
             __ emit(OP_PUSH_C, cells);
@@ -444,19 +538,20 @@ CodeGenerator::EmitPstruct(VarDeclBase* decl)
 
     std::vector<cell> values;
     values.resize(ps->fields().size());
+    std::vector<bool> zero_filled(values.size());
 
     auto init = decl->init_rhs()->as<StructExpr>();
     for (const auto& field : init->fields()) {
         auto arg = ps->FindField(field->name);
         if (auto expr = field->value->as<StringExpr>()) {
-            values[arg->offset()] = data_.dat_address();
-            data_.Add(expr->text()->chars(), expr->text()->length());
+            values[arg->offset()] = data_.Intern(expr->text()->chars(), expr->text()->length());
         } else if (auto expr = field->value->as<TaggedValueExpr>()) {
             values[arg->offset()] = expr->value();
         } else if (auto expr = field->value->as<SymbolExpr>()) {
             auto var = expr->decl()->as<VarDeclBase>();
             assert(var);
             values[arg->offset()] = var->addr();
+            zero_filled[arg->offset()] = var->is_zero_filled();
         } else {
             assert(false);
         }
@@ -464,8 +559,12 @@ CodeGenerator::EmitPstruct(VarDeclBase* decl)
 
     decl->BindAddress(data_.dat_address());
 
-    for (const auto& value : values)
-        data_.Add(value);
+    for (size_t i = 0; i < values.size(); i++) {
+        if (zero_filled[i])
+            data_.AddZeroFilledAddress(values[i]);
+        else
+            data_.Add(values[i]);
+    }
 }
 
 void
@@ -524,16 +623,26 @@ CodeGenerator::EmitExpr(Expr* expr)
         }
         case ExprKind::StringExpr: {
             auto se = expr->to<StringExpr>();
-            auto addr = data_.dat_address();
-            data_.Add(se->text()->chars(), se->text()->length());
+            cell addr;
+            if (literals_writable_) {
+                addr = data_.dat_address();
+                data_.Add(se->text()->chars(), se->text()->length());
+            } else {
+                addr = data_.Intern(se->text()->chars(), se->text()->length());
+            }
             __ const_pri(addr);
             break;
         }
         case ExprKind::ArrayExpr: {
             auto e = expr->to<ArrayExpr>();
-            auto addr = data_.dat_address();
+            tr::vector<cell> cells;
             for (const auto& expr : e->exprs())
-                data_.Add(expr->val().constval());
+                cells.emplace_back(expr->val().constval());
+            cell addr = data_.dat_address();
+            if (literals_writable_)
+                data_.Add(std::move(cells));
+            else if (!cells.empty())
+                addr = data_.Intern(std::move(cells));
             __ const_pri(addr);
             break;
         }
@@ -564,6 +673,71 @@ CodeGenerator::EmitExpr(Expr* expr)
     }
 }
 
+// Returns whether |expr| is a plain load of a scalar variable. These loads can
+// target either register without disturbing the other one, which lets us skip
+// the push/pop normally needed to preserve an operand.
+static bool
+IsSimpleRvalue(Expr* expr)
+{
+    if (expr->val().ident == iCONSTEXPR)
+        return false;
+
+    auto rvalue = expr->as<RvalueExpr>();
+    if (!rvalue || !rvalue->expr()->as<SymbolExpr>())
+        return false;
+
+    const auto& val = rvalue->expr()->val();
+    if (val.ident != iVARIABLE && val.ident != iREFERENCE)
+        return false;
+    return val.sym && val.sym->as<VarDeclBase>();
+}
+
+void
+CodeGenerator::EmitSimpleRvalue(Expr* expr, regid reg)
+{
+    assert(IsSimpleRvalue(expr));
+
+    const auto& val = expr->to<RvalueExpr>()->expr()->val();
+    auto var = val.sym->as<VarDeclBase>();
+    if (val.ident == iREFERENCE) {
+        assert(var->vclass() == sLOCAL || var->vclass() == sARGUMENT);
+        __ emit(reg == sPRI ? OP_LREF_S_PRI : OP_LREF_S_ALT, var->addr());
+        return;
+    }
+
+    auto loc = LocateVar(var);
+    if (loc.on_stack)
+        __ emit(reg == sPRI ? OP_LOAD_S_PRI : OP_LOAD_S_ALT, loc.addr);
+    else
+        __ emit_global(reg == sPRI ? OP_LOAD_PRI : OP_LOAD_ALT, loc.global);
+}
+
+// Plain "var = constant;" statements do not need the value in PRI, so they
+// can be stored with const/const.s.
+bool
+CodeGenerator::EmitConstStoreStmt(Expr* expr)
+{
+    auto bin = expr->as<BinaryExpr>();
+    if (!bin || bin->token() != '=' || bin->assignop().sym || bin->array_copy_length())
+        return false;
+
+    auto left = bin->left()->as<SymbolExpr>();
+    const auto& right_val = bin->right()->val();
+    if (!left || left->val().ident != iVARIABLE || right_val.ident != iCONSTEXPR)
+        return false;
+
+    auto var = left->val().sym ? left->val().sym->as<VarDeclBase>() : nullptr;
+    if (!var)
+        return false;
+
+    AutoErrorPos aep(expr->pos());
+    if (var->vclass() == sLOCAL || var->vclass() == sARGUMENT)
+        __ emit(OP_CONST_S, var->addr(), right_val.constval());
+    else
+        __ emit_global(OP_CONST, var, right_val.constval());
+    return true;
+}
+
 void
 CodeGenerator::EmitTest(Expr* expr, bool jump_on_true, Label* target)
 {
@@ -579,6 +753,10 @@ CodeGenerator::EmitTest(Expr* expr, bool jump_on_true, Label* target)
             if (EmitChainedCompareExprTest(expr->to<ChainedCompareExpr>(), jump_on_true, target))
                 return;
             break;
+        case ExprKind::BinaryExpr:
+            if (EmitBinaryExprTest(expr->to<BinaryExpr>(), jump_on_true, target))
+                return;
+            break;
         case ExprKind::CommaExpr: {
             auto ce = expr->to<CommaExpr>();
             for (size_t i = 0; i < ce->exprs().size() - 1; i++)
@@ -781,14 +959,11 @@ CodeGenerator::EmitBinary(BinaryExpr* expr)
 }
 
 void
-CodeGenerator::EmitBinaryInner(int oper_tok, const UserOperation& in_user_op, Expr* left,
-                               Expr* right)
+CodeGenerator::EmitBinaryOperands(int oper_tok, UserOperation* user_op, Expr* left, Expr* right)
 {
     const auto& left_val = left->val();
     const auto& right_val = right->val();
 
-    UserOperation user_op = in_user_op;
-
     // left goes into ALT, right goes into PRI, though we can swap them for
     // commutative operations.
     if (left_val.ident == iCONSTEXPR) {
@@ -805,13 +980,22 @@ CodeGenerator::EmitBinaryInner(int oper_tok, const UserOperation& in_user_op, Ex
         if (right_val.ident == iCONSTEXPR) {
             if (commutative(oper_tok)) {
                 __ const_alt(right_val.constval());
-                user_op.swapparams ^= true;
+                user_op->swapparams ^= true;
             } else {
+                // Loading a constant leaves ALT alone, so a move is enough.
                 if (must_save_lhs)
-                    __ emit(OP_PUSH_PRI);
+                    __ emit(OP_MOVE_ALT);
                 __ const_pri(right_val.constval());
+            }
+        } else if (IsSimpleRvalue(right)) {
+            // Same as above, but for variable loads.
+            if (commutative(oper_tok)) {
+                EmitSimpleRvalue(right, sALT);
+                user_op->swapparams ^= true;
+            } else {
                 if (must_save_lhs)
-                    __ emit(OP_POP_ALT);
+                    __ emit(OP_MOVE_ALT);
+                EmitSimpleRvalue(right, sPRI);
             }
         } else {
             if (must_save_lhs)
@@ -821,6 +1005,14 @@ CodeGenerator::EmitBinaryInner(int oper_tok, const UserOperation& in_user_op, Ex
                 __ emit(OP_POP_ALT);
         }
     }
+}
+
+void
+CodeGenerator::EmitBinaryInner(int oper_tok, const UserOperation& in_user_op, Expr* left,
+                               Expr* right)
+{
+    UserOperation user_op = in_user_op;
+    EmitBinaryOperands(oper_tok, &user_op, left, right);
 
     if (oper_tok) {
         if (user_op.sym) {
@@ -1007,11 +1199,20 @@ CodeGenerator::EmitChainedCompareExprTest(ChainedCompareExpr* root, bool jump_on
     Expr* left = root->first();
     Expr* right = root->ops()[0].expr;
 
+    // The compare-and-jump opcodes test PRI against ALT. If the right-hand
+    // side can be loaded straight into ALT, there is no need to shuffle the
+    // operands through the stack.
     EmitExpr(left);
-    __ emit(OP_PUSH_PRI);
-    EmitExpr(right);
-    __ emit(OP_POP_ALT);
-    __ emit(OP_XCHG);
+    if (right->val().ident == iCONSTEXPR) {
+        __ const_alt(right->val().constval());
+    } else if (IsSimpleRvalue(right)) {
+        EmitSimpleRvalue(right, sALT);
+    } else {
+        __ emit(OP_PUSH_PRI);
+        EmitExpr(right);
+        __ emit(OP_POP_ALT);
+        __ emit(OP_XCHG);
+    }
 
     int token = root->ops()[0].token;
     if (!jump_on_true) {
@@ -1036,6 +1237,30 @@ CodeGenerator::EmitChainedCompareExprTest(ChainedCompareExpr* root, bool jump_on
     return true;
 }
 
+bool
+CodeGenerator::EmitBinaryExprTest(BinaryExpr* expr, bool jump_on_true, Label* target)
+{
+    // Fold == and != into jeq/jneq. User operators go through a call, so
+    // they keep the generic path.
+    int token = expr->token();
+    if (token != tlEQ && token != tlNE)
+        return false;
+    if (expr->val().ident == iCONSTEXPR || expr->userop().sym)
+        return false;
+
+    Expr* left = expr->left();
+    Expr* right = expr->right();
+    if (left->val().ident != iCONSTEXPR)
+        EmitExpr(left);
+
+    UserOperation user_op = expr->userop();
+    EmitBinaryOperands(token, &user_op, left, right);
+
+    bool jump_on_equal = (token == tlEQ) == jump_on_true;
+    __ emit(jump_on_equal ? OP_JEQ : OP_JNEQ, target);
+    return true;
+}
+
 void
 CodeGenerator::EmitChainedCompareExpr(ChainedCompareExpr* root)
 {
@@ -1104,6 +1329,18 @@ CodeGenerator::EmitSymbolExpr(SymbolExpr* expr)
 void
 CodeGenerator::EmitIndexExpr(IndexExpr* expr)
 {
+    // Sub-arrays hoisted out of an enclosing loop are read from their slot.
+    // If the slot is zero, the index was out of bounds, so fall through to
+    // the full computation and let it report the error.
+    Label hoisted_done;
+    auto hoisted = hoisted_loads_.find(expr);
+    if (hoisted != hoisted_loads_.end()) {
+        __ emit(OP_LOAD_S_PRI, hoisted->second.addr);
+        if (!hoisted->second.checked)
+            return;
+        __ emit(OP_JNZ, &hoisted_done);
+    }
+
     EmitExpr(expr->base());
 
     auto& base_val = expr->base()->val();
@@ -1126,8 +1363,16 @@ CodeGenerator::EmitIndexExpr(IndexExpr* expr)
             }
         }
     } else {
-        __ emit(OP_PUSH_PRI);
-        EmitExpr(expr->index());
+        // Simple index loads leave ALT alone, so the base address doesn't
+        // have to go through the stack.
+        bool simple_index = IsSimpleRvalue(expr->index());
+        if (simple_index) {
+            __ emit(OP_MOVE_ALT);
+            EmitSimpleRvalue(expr->index(), sPRI);
+        } else {
+            __ emit(OP_PUSH_PRI);
+            EmitExpr(expr->index());
+        }
 
         if (base_val.array_size()) {
             __ emit(OP_BOUNDS, base_val.array_size() - 1); /* run time check for array bounds */
@@ -1136,13 +1381,12 @@ CodeGenerator::EmitIndexExpr(IndexExpr* expr)
             __ emit(OP_BOUNDS, INT_MAX); 
         }
 
-        if (magic_string) {
+        if (!simple_index)
             __ emit(OP_POP_ALT);
+        if (magic_string)
             __ emit(OP_ADD);
-        } else {
-            __ emit(OP_POP_ALT);
+        else
             __ emit(OP_IDXADDR);
-        }
     }
 
     // The indexed item is another array (multi-dimensional arrays).
@@ -1150,6 +1394,9 @@ CodeGenerator::EmitIndexExpr(IndexExpr* expr)
         assert(expr->val().ident == iARRAY || expr->val().ident == iREFARRAY);
         __ emit(OP_LOAD_I);
     }
+
+    if (hoisted_done.used())
+        __ bind(&hoisted_done);
 }
 
 void
@@ -1179,6 +1426,9 @@ CodeGenerator::EmitCallExpr(CallExpr* call)
 {
     auto& val = call->val();
 
+    if (!val.sym && EmitInlineCall(call))
+        return;
+
     // If returning an array, push a hidden parameter.
     if (val.sym) {
         auto var = val.sym->as<VarDecl>();
@@ -1195,7 +1445,28 @@ CodeGenerator::EmitCallExpr(CallExpr* call)
     for (size_t i = argv.size() - 1; i < argv.size(); i--) {
         const auto& expr = argv[i];
 
-        EmitExpr(expr);
+        ArgDecl* arg;
+        if (i < arginfov.size()) {
+            arg = arginfov[i];
+        } else {
+            arg = arginfov.back();
+            assert(arg->type_info().ident == iVARARGS);
+        }
+
+        if (EmitPushArg(expr, arg))
+            continue;
+
+        // The callee may write through a non-const array or reference
+        // parameter (variadic arguments are passed by reference), so literals
+        // passed to one can't share the interned copy. By-value parameters
+        // only receive a copy.
+        {
+            int ident = arg->type_info().ident;
+            bool by_ref = ident == iREFARRAY || ident == iREFERENCE || ident == iVARARGS;
+            ke::SaveAndSet<bool> writable(&literals_writable_,
+                                          by_ref && !arg->type_info().is_const);
+            EmitExpr(expr);
+        }
 
         if (expr->as<DefaultArgExpr>()) {
             __ emit(OP_PUSH_PRI);
@@ -1205,14 +1476,6 @@ CodeGenerator::EmitCallExpr(CallExpr* call)
         const auto& val = expr->val();
         bool lvalue = expr->lvalue();
 
-        ArgDecl* arg;
-        if (i < arginfov.size()) {
-            arg = arginfov[i];
-        } else {
-            arg = arginfov.back();
-            assert(arg->type_info().ident == iVARARGS);
-        }
-
         switch (arg->type_info().ident) {
             case iVARARGS:
                 if (val.ident == iVARIABLE || val.ident == iREFERENCE) {
@@ -1260,6 +1523,184 @@ CodeGenerator::EmitCallExpr(CallExpr* call)
         __ emit(OP_POP_PRI);
 }
 
+// Arguments that are constants, plain variables, or addresses can be pushed
+// directly with push.c/push/push.s/push.adr, which the assembler then folds
+// into the pushN forms. Returns false if the generic path is needed.
+bool
+CodeGenerator::EmitPushArg(Expr* expr, ArgDecl* arg)
+{
+    const auto& val = expr->val();
+    auto arg_ident = arg->type_info().ident;
+
+    if (auto def = expr->as<DefaultArgExpr>()) {
+        if (arg_ident != iVARIABLE)
+            return false;
+        __ emit(OP_PUSH_C, def->arg()->default_value()->val.get());
+        return true;
+    }
+
+    switch (arg_ident) {
+        case iVARIABLE:
+            if (val.ident == iCONSTEXPR) {
+                __ emit(OP_PUSH_C, val.constval());
+                return true;
+            }
+            if (IsSimpleRvalue(expr)) {
+                const auto& inner = expr->to<RvalueExpr>()->expr()->val();
+                if (inner.ident != iVARIABLE)
+                    return false;
+                auto var = inner.sym->as<VarDeclBase>();
+                if (var->vclass() == sLOCAL || var->vclass() == sARGUMENT)
+                    __ emit(OP_PUSH_S, var->addr());
+                else
+                    __ emit_global(OP_PUSH, var);
+                return true;
+            }
+            return false;
+
+        case iREFARRAY:
+            if (auto se = expr->as<StringExpr>()) {
+                if (!arg->type_info().is_const)
+                    return false;
+                auto addr = data_.Intern(se->text()->chars(), se->text()->length());
+                __ emit(OP_PUSH_C, addr);
+                return true;
+            }
+            if (auto sym = expr->as<SymbolExpr>()) {
+                if (val.ident != iARRAY && val.ident != iREFARRAY)
+                    return false;
+                if (sym->decl()->ident() != iARRAY && sym->decl()->ident() != iREFARRAY)
+                    return false;
+                __ push_address(sym->decl()->as<VarDeclBase>());
+                return true;
+            }
+            return false;
+
+        case iREFERENCE:
+        case iVARARGS:
+            if (!expr->as<SymbolExpr>() || !expr->lvalue())
+                return false;
+            if (val.ident != iVARIABLE && val.ident != iREFERENCE)
+                return false;
+            assert(val.sym);
+
+            // See the const handling for varargs in EmitCallExpr.
+            if (arg_ident == iVARARGS && val.sym->is_const() && !arg->type_info().is_const)
+                return false;
+
+            __ push_address(val.sym->as<VarDeclBase>());
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+// Emit the body of a small function in place of a call (see Inliner).
+// Arguments that are plain variables are read in place; anything else is
+// stored into the caller's inline argument slots, at the top of its frame.
+bool
+CodeGenerator::EmitInlineCall(CallExpr* call)
+{
+    if (!call->is_inlined())
+        return false;
+
+    auto fun = call->fun()->impl();
+    const auto& argv = call->args();
+    const auto& args = fun->args();
+    assert(argv.size() == args.size());
+    assert(args.size() <= (size_t)fun_->inline_slots());
+
+    // Arguments can only be read in place if no other argument has side
+    // effects, otherwise we could observe writes from later arguments.
+    bool all_simple = true;
+    for (const auto& expr : argv) {
+        if (!expr->as<DefaultArgExpr>() && expr->val().ident != iCONSTEXPR &&
+            !IsSimpleRvalue(expr))
+        {
+            all_simple = false;
+            break;
+        }
+    }
+
+    auto slot = [](size_t i) -> cell {
+        return -cell((i + 1) * sizeof(cell));
+    };
+
+    tr::vector<VarLocation> locations;
+    if (all_simple) {
+        for (size_t i = 0; i < argv.size(); i++) {
+            Expr* expr = argv[i];
+            if (auto def = expr->as<DefaultArgExpr>()) {
+                __ emit(OP_CONST_S, slot(i), def->arg()->default_value()->val.get());
+                locations.push_back({true, slot(i)});
+            } else if (expr->val().ident == iCONSTEXPR) {
+                __ emit(OP_CONST_S, slot(i), expr->val().constval());
+                locations.push_back({true, slot(i)});
+            } else {
+                const auto& inner = expr->to<RvalueExpr>()->expr()->val();
+                auto var = inner.sym->as<VarDeclBase>();
+                if (inner.ident == iVARIABLE) {
+                    locations.push_back(LocateVar(var));
+                } else {
+                    EmitSimpleRvalue(expr, sPRI);
+                    __ emit(OP_STOR_S_PRI, slot(i));
+                    locations.push_back({true, slot(i)});
+                }
+            }
+        }
+    } else {
+        // Evaluate right-to-left like a normal call. Arguments may contain
+        // other inlined calls, which use the same slots, so nothing is stored
+        // until every argument has been evaluated.
+        for (size_t i = argv.size() - 1; i < argv.size(); i--) {
+            if (!EmitPushArg(argv[i], args[i])) {
+                EmitExpr(argv[i]);
+                __ emit(OP_PUSH_PRI);
+            }
+        }
+        for (size_t i = 0; i < argv.size(); i++) {
+            __ emit(OP_POP_PRI);
+            __ emit(OP_STOR_S_PRI, slot(i));
+            locations.push_back({true, slot(i)});
+        }
+        max_func_memory_ = std::max(max_func_memory_, current_memory_ + (int)argv.size());
+    }
+
+    // The body cannot contain calls, so inlined bodies never nest.
+    assert(inline_args_.empty());
+    for (size_t i = 0; i < args.size(); i++)
+        inline_args_.emplace(args[i], locations[i]);
+
+    // Attribute the body to the callee's line, as long as the line table
+    // still refers to the same file.
+    auto ret = fun->inline_return();
+    bool same_file = cc_.sources()->IsSameSourceFile(call->pos(), ret->pos());
+    if (same_file)
+        AddDebugLine(ret->pos().line);
+
+    EmitExpr(ret->expr());
+
+    if (same_file)
+        AddDebugLine(call->pos().line);
+
+    inline_args_.clear();
+    return true;
+}
+
+CodeGenerator::VarLocation
+CodeGenerator::LocateVar(VarDeclBase* var)
+{
+    if (!inline_args_.empty()) {
+        auto iter = inline_args_.find(var);
+        if (iter != inline_args_.end())
+            return iter->second;
+    }
+    if (var->vclass() == sLOCAL || var->vclass() == sARGUMENT)
+        return {true, var->addr()};
+    return {false, var->addr(), var};
+}
+
 void
 CodeGenerator::EmitDefaultArgExpr(DefaultArgExpr* expr)
 {
@@ -1373,9 +1814,8 @@ CodeGenerator::EmitReturnArrayStmt(ReturnStmt* stmt)
         assert(array.zeroes);
 
         info->iv_size = (cell_t)array.iv.size();
-        info->dat_addr = data_.dat_address();
         info->zeroes = array.zeroes;
-        data_.Add(std::move(array.iv));
+        info->dat_addr = data_.Intern(std::move(array.iv));
     }
 
     cell dat_addr = info->dat_addr;
@@ -1501,11 +1941,11 @@ CodeGenerator::EmitRvalue(value* lval)
             lval->ident = iEXPRESSION;
             break;
         default: {
-            auto var = lval->sym->as<VarDeclBase>();
-            if (var->vclass() == sLOCAL || var->vclass() == sARGUMENT)
-              __ emit(OP_LOAD_S_PRI, var->addr());
+            auto loc = LocateVar(lval->sym->as<VarDeclBase>());
+            if (loc.on_stack)
+              __ emit(OP_LOAD_S_PRI, loc.addr);
             else
-              __ emit(OP_LOAD_PRI, var->addr());
+              __ emit_global(OP_LOAD_PRI, loc.global);
             break;
         }
     }
@@ -1535,7 +1975,7 @@ CodeGenerator::EmitStore(const value* lval)
             if (var->vclass() == sLOCAL || var->vclass() == sARGUMENT)
                 __ emit(OP_STOR_S_PRI, var->addr());
             else
-                __ emit(OP_STOR_PRI, var->addr());
+                __ emit_global(OP_STOR_PRI, var);
             break;
         }
     }
@@ -1566,6 +2006,9 @@ CodeGenerator::EmitDoWhileStmt(DoWhileStmt* stmt)
     int token = stmt->token();
     assert(token == tDO || token == tWHILE);
 
+    tr::vector<IndexExpr*> hoisted;
+    HoistSubarrayLoads(stmt->body(), stmt->cond(), nullptr, &hoisted);
+
     LoopContext loop_cx;
     loop_cx.stack_scope_id = stack_scope_id();
     loop_cx.heap_scope_id = heap_scope_id();
@@ -1623,6 +2066,8 @@ CodeGenerator::EmitDoWhileStmt(DoWhileStmt* stmt)
     }
 
     __ bind(&loop_cx.break_to);
+
+    DropHoistedLoads(hoisted);
 }
 
 void
@@ -1646,6 +2091,296 @@ CodeGenerator::EmitLoopControl(int token)
         __ emit(OP_JUMP, &loop_->continue_to);
 }
 
+// Maximum number of distinct sub-array loads hoisted out of one loop.
+static const size_t kMaxHoistedLoads = 4;
+
+// Collects the sub-array loads ("arr[k]" on a multi-dimensional array) in a
+// loop, and every variable the loop might write. A variable counts as written
+// if it appears anywhere other than as a plain read or as an indexed array,
+// which covers assignments, increments, reference arguments and locals
+// declared inside the loop. Any node the scanner doesn't know about makes it
+// give up.
+class SubarrayLoadScanner
+{
+  public:
+    bool Scan(Stmt* stmt) {
+        switch (stmt->kind()) {
+            case StmtKind::StmtList:
+                return ScanList(stmt->to<StmtList>()->stmts());
+            case StmtKind::BlockStmt:
+                return ScanList(stmt->to<BlockStmt>()->stmts());
+            case StmtKind::ExprStmt:
+                return Scan(stmt->to<ExprStmt>()->expr());
+            case StmtKind::ReturnStmt:
+                return ScanOpt(stmt->to<ReturnStmt>()->expr());
+            case StmtKind::AssertStmt:
+                return Scan(stmt->to<AssertStmt>()->expr());
+            case StmtKind::DeleteStmt:
+                return Scan(stmt->to<DeleteStmt>()->expr());
+            case StmtKind::ExitStmt:
+                return ScanOpt(stmt->to<ExitStmt>()->expr());
+            case StmtKind::IfStmt: {
+                auto s = stmt->to<IfStmt>();
+                return Scan(s->cond()) && Scan(s->on_true()) &&
+                       (!s->on_false() || Scan(s->on_false()));
+            }
+            case StmtKind::DoWhileStmt: {
+                auto s = stmt->to<DoWhileStmt>();
+                return Scan(s->cond()) && Scan(s->body());
+            }
+            case StmtKind::ForStmt: {
+                auto s = stmt->to<ForStmt>();
+                return (!s->init() || Scan(s->init())) && ScanOpt(s->cond()) &&
+                       ScanOpt(s->advance()) && Scan(s->body());
+            }
+            case StmtKind::SwitchStmt: {
+                auto s = stmt->to<SwitchStmt>();
+                if (!Scan(s->expr()))
+                    return false;
+                for (const auto& entry : s->cases()) {
+                    if (!Scan(entry.second))
+                        return false;
+                }
+                return !s->default_case() || Scan(s->default_case());
+            }
+            case StmtKind::VarDecl: {
+                auto decl = stmt->to<VarDecl>();
+                written_.emplace(decl);
+                return !decl->init() || Scan(decl->init());
+            }
+            case StmtKind::BreakStmt:
+            case StmtKind::ContinueStmt:
+            case StmtKind::ConstDecl:
+            case StmtKind::StaticAssertStmt:
+            case StmtKind::PragmaUnusedStmt:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool Scan(Expr* expr) {
+        // Constants are emitted without looking at their operands.
+        if (expr->val().ident == iCONSTEXPR)
+            return true;
+
+        switch (expr->kind()) {
+            case ExprKind::RvalueExpr: {
+                auto inner = expr->to<RvalueExpr>()->expr();
+                if (inner->as<SymbolExpr>())
+                    return true;
+                return Scan(inner);
+            }
+            case ExprKind::SymbolExpr:
+                written_.emplace(expr->to<SymbolExpr>()->decl());
+                return true;
+            case ExprKind::ThisExpr:
+                written_.emplace(expr->to<ThisExpr>()->decl());
+                return true;
+            case ExprKind::IndexExpr: {
+                auto e = expr->to<IndexExpr>();
+                if (e->base()->as<SymbolExpr>()) {
+                    if (e->base()->val().array_dim_count() > 1)
+                        loads_.emplace_back(e);
+                } else if (!Scan(e->base())) {
+                    return false;
+                }
+                return Scan(e->index());
+            }
+            case ExprKind::UnaryExpr:
+                return Scan(expr->to<UnaryExpr>()->expr());
+            case ExprKind::IncDecExpr:
+                return Scan(expr->to<IncDecExpr>()->expr());
+            case ExprKind::CastExpr:
+                return Scan(expr->to<CastExpr>()->expr());
+            case ExprKind::CallUserOpExpr:
+                return Scan(expr->to<CallUserOpExpr>()->expr());
+            case ExprKind::FieldAccessExpr:
+                return Scan(expr->to<FieldAccessExpr>()->base());
+            case ExprKind::BinaryExpr: {
+                auto e = expr->to<BinaryExpr>();
+                return Scan(e->left()) && Scan(e->right());
+            }
+            case ExprKind::LogicalExpr: {
+                auto e = expr->to<LogicalExpr>();
+                return Scan(e->left()) && Scan(e->right());
+            }
+            case ExprKind::ChainedCompareExpr: {
+                auto e = expr->to<ChainedCompareExpr>();
+                if (!Scan(e->first()))
+                    return false;
+                for (const auto& op : e->ops()) {
+                    if (!Scan(op.expr))
+                        return false;
+                }
+                return true;
+            }
+            case ExprKind::TernaryExpr: {
+                auto e = expr->to<TernaryExpr>();
+                return Scan(e->first()) && Scan(e->second()) && Scan(e->third());
+            }
+            case ExprKind::CallExpr: {
+                auto e = expr->to<CallExpr>();
+                if (!ScanOpt(e->implicit_this()))
+                    return false;
+                return ScanList(e->args());
+            }
+            case ExprKind::CommaExpr:
+                return ScanList(expr->to<CommaExpr>()->exprs());
+            case ExprKind::NewArrayExpr:
+                return ScanList(expr->to<NewArrayExpr>()->exprs());
+            case ExprKind::ArrayExpr:
+                return ScanList(expr->to<ArrayExpr>()->exprs());
+            case ExprKind::SizeofExpr:
+            case ExprKind::DefaultArgExpr:
+            case ExprKind::NullExpr:
+            case ExprKind::TaggedValueExpr:
+            case ExprKind::StringExpr:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool ScanOpt(Expr* expr) {
+        return !expr || Scan(expr);
+    }
+
+    // Returns whether |load| reads the same sub-array on every iteration: the
+    // array has a fixed size and is never replaced, and the index is either a
+    // constant or a local the loop never writes. Globals and statics could be
+    // changed by any call, so their loads stay in the loop.
+    bool IsInvariant(IndexExpr* load) const {
+        const auto& base_val = load->base()->val();
+        auto var = load->base()->to<SymbolExpr>()->decl()->as<VarDeclBase>();
+        if (!var || written_.count(var) || base_val.array_size() <= 0)
+            return false;
+
+        Expr* index = load->index();
+        if (index->val().ident == iCONSTEXPR)
+            return true;
+        auto rvalue = index->as<RvalueExpr>();
+        if (!rvalue || !rvalue->expr()->as<SymbolExpr>())
+            return false;
+        const auto& index_val = rvalue->expr()->val();
+        auto index_var = index_val.sym ? index_val.sym->as<VarDeclBase>() : nullptr;
+        if (index_val.ident != iVARIABLE || !index_var || written_.count(index_var))
+            return false;
+        return index_var->vclass() == sLOCAL || index_var->vclass() == sARGUMENT;
+    }
+
+    const tr::vector<IndexExpr*>& loads() const { return loads_; }
+
+  private:
+    template <typename T>
+    bool ScanList(PoolArray<T*>& nodes) {
+        for (const auto& node : nodes) {
+            if (!Scan(node))
+                return false;
+        }
+        return true;
+    }
+
+  private:
+    tr::vector<IndexExpr*> loads_;
+    tr::unordered_set<Decl*> written_;
+};
+
+// Returns whether two loads read the same element of the same array.
+static bool
+IsSameSubarrayLoad(IndexExpr* a, IndexExpr* b)
+{
+    if (a->base()->to<SymbolExpr>()->decl() != b->base()->to<SymbolExpr>()->decl())
+        return false;
+
+    const auto& a_val = a->index()->val();
+    const auto& b_val = b->index()->val();
+    if (a_val.ident == iCONSTEXPR || b_val.ident == iCONSTEXPR)
+        return a_val.ident == b_val.ident && a_val.constval() == b_val.constval();
+    return a->index()->to<RvalueExpr>()->expr()->val().sym ==
+           b->index()->to<RvalueExpr>()->expr()->val().sym;
+}
+
+// Computes the invariant sub-array loads of a loop once, before the loop,
+// into stack slots that EmitIndexExpr reads instead. The slots live in their
+// own stack scope, which the caller must enter before the loop context and
+// close with DropHoistedLoads.
+//
+// A load with a variable index is only computed if the index is in bounds,
+// and its slot is zero otherwise. That keeps the loop's behavior exact: a
+// loop that never reaches the load doesn't fault, and one that does faults
+// at the same place it always did.
+void
+CodeGenerator::HoistSubarrayLoads(Stmt* body, Expr* cond, Expr* advance,
+                                  tr::vector<IndexExpr*>* hoisted)
+{
+    if (!cc_.options()->hoist_loop_loads)
+        return;
+
+    SubarrayLoadScanner scanner;
+    if (!scanner.Scan(body) || !scanner.ScanOpt(cond) || !scanner.ScanOpt(advance))
+        return;
+
+    tr::vector<IndexExpr*> leaders;
+    for (IndexExpr* load : scanner.loads()) {
+        if (hoisted_loads_.count(load) || !scanner.IsInvariant(load))
+            continue;
+
+        IndexExpr* leader = nullptr;
+        for (IndexExpr* other : leaders) {
+            if (IsSameSubarrayLoad(load, other)) {
+                leader = other;
+                break;
+            }
+        }
+
+        if (!leader) {
+            if (leaders.size() == kMaxHoistedLoads)
+                continue;
+            if (leaders.empty())
+                pushstacklist();
+
+            bool checked = load->index()->val().ident != iCONSTEXPR;
+            markstack(load, MEMUSE_STATIC, 1);
+            cell addr = -cell(current_stack_ * sizeof(cell));
+            if (checked) {
+                __ emit(OP_PUSH_C, static_cast<cell_t>(0));
+
+                // The VM's bounds check is unsigned; do it as two signed
+                // tests so an out-of-bounds index just skips the load.
+                Label skip;
+                EmitSimpleRvalue(load->index(), sPRI);
+                __ const_alt(0);
+                __ emit(OP_JSLESS, &skip);
+                __ const_alt(load->base()->val().array_size() - 1);
+                __ emit(OP_JSGRTR, &skip);
+                EmitIndexExpr(load);
+                __ emit(OP_STOR_S_PRI, addr);
+                __ bind(&skip);
+            } else {
+                EmitIndexExpr(load);
+                __ emit(OP_PUSH_PRI);
+            }
+
+            leaders.emplace_back(load);
+            hoisted_loads_.emplace(load, HoistedLoad{addr, checked});
+        } else {
+            hoisted_loads_.emplace(load, hoisted_loads_.at(leader));
+        }
+        hoisted->emplace_back(load);
+    }
+}
+
+void
+CodeGenerator::DropHoistedLoads(const tr::vector<IndexExpr*>& hoisted)
+{
+    if (hoisted.empty())
+        return;
+    for (IndexExpr* load : hoisted)
+        hoisted_loads_.erase(load);
+    popstacklist(true);
+}
+
 void
 CodeGenerator::EmitForStmt(ForStmt* stmt)
 {
@@ -1661,6 +2396,10 @@ CodeGenerator::EmitForStmt(ForStmt* stmt)
     if (init)
         EmitStmt(init);
 
+    tr::vector<IndexExpr*> hoisted;
+    if (!stmt->never_taken())
+        HoistSubarrayLoads(stmt->body(), stmt->cond(), stmt->advance(), &hoisted);
+
     LoopContext loop_cx;
     loop_cx.stack_scope_id = stack_scope_id();
     loop_cx.heap_scope_id = heap_scope_id();
@@ -1726,6 +2465,8 @@ CodeGenerator::EmitForStmt(ForStmt* stmt)
     }
     __ bind(&loop_cx.break_to);
 
+    DropHoistedLoads(hoisted);
+
     if (scope) {
         debug_scope = {};
         popstacklist(true);
@@ -1741,7 +2482,8 @@ CodeGenerator::EmitSwitchStmt(SwitchStmt* stmt)
     Label table_label;
     __ emit(OP_SWITCH, &table_label);
 
-    // Note: we use map for ordering so the case table is sorted.
+    // Note: we use map for ordering so the case table is sorted. The VM
+    // rejects unsorted case tables, since it binary searches them.
     std::map<cell, Label> case_labels;
 
     for (const auto& case_entry : stmt->cases()) {
@@ -1789,8 +2531,11 @@ void CodeGenerator::EmitFunctionDecl(FunctionDecl* info) {
     current_memory_ = 16;
     max_func_memory_ = current_memory_;
 
-    if (!info->is_live())
+    if (!info->is_live()) {
+        if (info->body() && info->canonical() == info)
+            dead_functions_++;
         return;
+    }
 
     if (info->canonical() == info)
         cc_.functions().emplace(info);
@@ -1798,12 +2543,30 @@ void CodeGenerator::EmitFunctionDecl(FunctionDecl* info) {
     if (!info->body())
         return;
 
+    // The parser only skips bodies it proved unreachable. If one is live
+    // anyway, the empty stand-in body would be emitted in its place.
+    if (info->is_body_skipped()) {
+        report(info, 446) << info->name();
+        return;
+    }
+
+    uint32_t start_pc = asm_.pc();
+    uint32_t start_instructions = asm_.num_instructions();
+
     __ bind(&info->cg()->label);
     __ emit(OP_PROC);
     AddDebugLine(info->pos().line);
     EmitBreak();
     current_stack_ = 0;
 
+    // Arguments to inlined calls go in the first cells of the frame; see
+    // EmitInlineCall.
+    if (int slots = info->inline_slots()) {
+        pushstacklist();
+        markstack(info, MEMUSE_STATIC, slots);
+        __ emit(OP_STACK, -cell(slots * sizeof(cell)));
+    }
+
     {
         AutoEnterScope arg_scope(this, &local_syms_);
 
@@ -1813,6 +2576,10 @@ void CodeGenerator::EmitFunctionDecl(FunctionDecl* info) {
         EmitStmt(info->body());
     }
 
+    // Every path through the body ends in a return, which releases the frame.
+    if (info->inline_slots())
+        popstacklist(false);
+
     assert(!has_stack_or_heap_scopes());
 
     // If return keyword is missing, we added it in the semantic pass.
@@ -1824,6 +2591,9 @@ void CodeGenerator::EmitFunctionDecl(FunctionDecl* info) {
     info->cg()->pcode_end = asm_.pc();
     info->cg()->max_local_stack = max_func_memory_;
 
+    function_stats_.emplace_back(FunctionStats{info, asm_.pc() - start_pc,
+                                               asm_.num_instructions() - start_instructions});
+
     // In case there is no callgraph, we still need to track which function has
     // the biggest stack.
     max_script_memory_ = std::max(max_script_memory_, max_func_memory_);
@@ -1893,11 +2663,13 @@ CodeGenerator::EmitDefaultArray(Expr* expr, ArgDecl* arg)
     }
 
     if (!def->val) {
-        def->val = ke::Some(data_.dat_address());
-
-        data_.Add(std::move(def->array->iv));
-        data_.Add(std::move(def->array->data));
-        data_.AddZeroes(def->array->zeroes);
+        // Const arguments are passed this copy directly, and non-const ones
+        // get a fresh heap copy below, so the data itself is never written.
+        tr::vector<cell> run = std::move(def->array->iv);
+        run.insert(run.end(), def->array->data.begin(), def->array->data.end());
+        run.resize(run.size() + def->array->zeroes, 0);
+        def->array->data.clear();
+        def->val = ke::Some(data_.Intern(std::move(run)));
     }
 
     if (arg->type_info().is_const || !def->array) {
@@ -2020,7 +2792,7 @@ void CodeGenerator::EmitInc(const value* lval)
             if (var->vclass() == sLOCAL || var->vclass() == sARGUMENT)
                 __ emit(OP_INC_S, var->addr());
             else
-                __ emit(OP_INC, var->addr());
+                __ emit_global(OP_INC, var);
             break;
         }
     }
@@ -2060,7 +2832,7 @@ void CodeGenerator::EmitDec(const value* lval)
             if (var->vclass() == sLOCAL || var->vclass() == sARGUMENT)
                 __ emit(OP_DEC_S, var->addr());
             else
-                __ emit(OP_DEC, var->addr());
+                __ emit_global(OP_DEC, var);
             break;
         }
     }
@@ -2198,6 +2970,8 @@ int CodeGenerator::DynamicMemorySize() const {
 }
 
 void CodeGenerator::EnqueueDebugSymbol(Decl* decl, uint32_t pc) {
+    __ fence();
+
     int vclass = 0;
     if (auto fun = decl->as<FunctionDecl>())
         vclass = fun->is_static() ? sSTATIC : sGLOBAL;
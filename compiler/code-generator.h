@@ -50,11 +50,27 @@ class CodeGenerator final
 
     const uint8_t* code_ptr() const { return asm_.bytes(); }
     uint32_t code_size() const { return (uint32_t)asm_.size(); }
+    uint32_t num_instructions() const { return asm_.num_instructions(); }
+    uint32_t num_fused_instructions() const { return asm_.num_fused(); }
     const uint8_t* data_ptr() const { return data_.dat(); }
     uint32_t data_size() const { return data_.size(); }
+    uint32_t data_initialized_size() const { return data_.initialized_size(); }
+    uint32_t data_merged_size() const { return data_.merged_size(); }
 
     int DynamicMemorySize() const;
 
+    struct FunctionStats {
+        FunctionDecl* decl;
+        uint32_t code_size;
+        uint32_t instructions;
+    };
+    const tr::vector<FunctionStats>& function_stats() const { return function_stats_; }
+
+    // Functions and globals dropped because nothing live refers to them.
+    uint32_t dead_functions() const { return dead_functions_; }
+    uint32_t dead_globals() const { return dead_globals_; }
+    uint32_t dead_global_bytes() const { return dead_global_bytes_; }
+
   private:
     // Statements/decls.
     void EmitStmtList(StmtList* list);
@@ -63,6 +79,10 @@ class CodeGenerator final
     void EmitVarDecl(VarDeclBase* decl);
     void EmitPstruct(VarDeclBase* decl);
     void EmitGlobalVar(VarDeclBase* decl);
+    void AddZeroFilledVar(VarDeclBase* decl, cell bytes);
+    void PlaceZeroFilledData();
+    bool IsDeadGlobal(VarDeclBase* decl);
+    void DropGlobalVar(VarDeclBase* decl);
     void EmitLocalVar(VarDeclBase* decl);
     void EmitIfStmt(IfStmt* stmt);
     void EmitDeleteStmt(DeleteStmt* stmt);
@@ -82,6 +102,9 @@ class CodeGenerator final
     void EmitIncDec(IncDecExpr* expr);
     void EmitBinary(BinaryExpr* expr);
     void EmitBinaryInner(int oper_tok, const UserOperation& in_user_op, Expr* left, Expr* right);
+    void EmitBinaryOperands(int oper_tok, UserOperation* user_op, Expr* left, Expr* right);
+    void EmitSimpleRvalue(Expr* expr, regid reg);
+    bool EmitConstStoreStmt(Expr* expr);
     void EmitLogicalExpr(LogicalExpr* expr);
     void EmitChainedCompareExpr(ChainedCompareExpr* expr);
     void EmitTernaryExpr(TernaryExpr* expr);
@@ -98,8 +121,20 @@ class CodeGenerator final
     void EmitLogicalExprTest(LogicalExpr* expr, bool jump_on_true, sp::Label* target);
     bool EmitChainedCompareExprTest(ChainedCompareExpr* expr, bool jump_on_true,
                                     sp::Label* target);
+    bool EmitBinaryExprTest(BinaryExpr* expr, bool jump_on_true, sp::Label* target);
 
     void EmitDefaultArray(Expr* expr, ArgDecl* arg);
+    bool EmitPushArg(Expr* expr, ArgDecl* arg);
+    bool EmitInlineCall(CallExpr* call);
+
+    // Where a variable's value lives: a frame offset, or a data address.
+    struct VarLocation {
+        bool on_stack;
+        cell addr;
+        VarDeclBase* global = nullptr;
+    };
+    VarLocation LocateVar(VarDeclBase* var);
+
     void EmitUserOp(const UserOperation& user_op, value* lval);
     void EmitCall(FunctionDecl* fun, cell nargs);
     void EmitInc(const value* lval);
@@ -120,6 +155,7 @@ class CodeGenerator final
     void AddDebugFile(const std::string& line);
     void AddDebugLine(int linenr);
     void AddDebugSymbol(Decl* sym, uint32_t pc);
+    void AddDebugSymbol(Decl* sym, uint32_t pc, uint32_t end_pc, FunctionDecl* owner);
     void AddDebugSymbols(tr::vector<DebugSymbol>* list);
     void EnqueueDebugSymbol(Decl* decl, uint32_t pc);
 
@@ -127,6 +163,11 @@ class CodeGenerator final
     void EmitExprForStmt(Expr* expr);
     void EmitLoopControl(int token);
 
+    // Loop-invariant sub-array loads.
+    void HoistSubarrayLoads(Stmt* body, Expr* cond, Expr* advance,
+                            tr::vector<IndexExpr*>* hoisted);
+    void DropHoistedLoads(const tr::vector<IndexExpr*>& hoisted);
+
   private:
     enum MemuseType {
         MEMUSE_STATIC = 0,
@@ -222,9 +263,25 @@ class CodeGenerator final
 
     tr::vector<tr::string> debug_strings_;
     tr::vector<FunctionDecl*> native_list_;
+    tr::vector<FunctionStats> function_stats_;
+    uint32_t dead_functions_ = 0;
+    uint32_t dead_globals_ = 0;
+    uint32_t dead_global_bytes_ = 0;
     sp::SmxAssemblyBuffer asm_;
     DataQueue data_;
 
+    // Globals placed in the zero-filled region, and debug symbols for them
+    // that wait until the region has an address.
+    struct ZeroFilledSymbol {
+        Decl* decl;
+        uint32_t pc;
+        uint32_t end_pc;
+        FunctionDecl* owner;
+    };
+    tr::vector<VarDeclBase*> zero_filled_vars_;
+    tr::vector<ZeroFilledSymbol> zero_filled_syms_;
+    bool zero_filled_placed_ = false;
+
     ke::Maybe<uint32_t> last_break_op_;
     tr::vector<MemoryScope> stack_scopes_;
     tr::vector<MemoryScope> heap_scopes_;
@@ -242,6 +299,23 @@ class CodeGenerator final
     };
     LoopContext* loop_ = nullptr;
 
+    // Set while emitting an argument the callee may write through. String
+    // and array literals then get a private copy instead of an interned one.
+    bool literals_writable_ = false;
+
+    // Sub-array loads hoisted out of the loops being emitted, and the stack
+    // slot holding each one. A checked slot is zero if the index was out of
+    // bounds when the loop was entered.
+    struct HoistedLoad {
+        cell addr;
+        bool checked;
+    };
+    tr::unordered_map<IndexExpr*, HoistedLoad> hoisted_loads_;
+
+    // While an inlined body is emitted, where each of the callee's arguments
+    // was placed by the caller.
+    tr::unordered_map<VarDeclBase*, VarLocation> inline_args_;
+
     int current_stack_ = 0;
     int current_memory_ = 0;
     int max_func_memory_ = 0;
@@ -32,7 +32,7 @@
 
 namespace sp {
 
-CompileContext* CompileContext::sInstance = nullptr;
+thread_local CompileContext* CompileContext::sInstance = nullptr;
 
 CompileContext::CompileContext()
   : globals_(nullptr)
@@ -83,12 +83,27 @@ tr::unordered_map<Atom*, Decl*>* CompileContext::NewSymbolMap() {
 void CompileContext::TrackMalloc(size_t bytes) {
     malloc_bytes_ += bytes;
     malloc_bytes_peak_ = std::max(malloc_bytes_peak_, malloc_bytes_);
+    SampleMemory();
 }
 
 void CompileContext::TrackFree(size_t bytes) {
+    // Pools can grow without going through malloc tracking, so sample before
+    // the total drops.
+    SampleMemory();
     malloc_bytes_ -= bytes;
 }
 
+void CompileContext::SampleMemory() {
+    size_t in_use = memory_in_use();
+    memory_peak_ = std::max(memory_peak_, in_use);
+    memory_watermark_ = std::max(memory_watermark_, in_use);
+}
+
+void CompileContext::ReleasePhaseMemory() {
+    SampleMemory();
+    phase_allocator_.Release();
+}
+
 void* NativeAllocator::Malloc(size_t n) {
     void* p = malloc(n);
     if (!p)
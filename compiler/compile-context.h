@@ -20,6 +20,7 @@
 //  3.  This notice may not be removed or altered from any source distribution.
 #pragma once
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <unordered_set>
@@ -52,7 +53,8 @@ class CompileContext final
     CompileContext();
     ~CompileContext();
 
-    static CompileContext* sInstance;
+    // Each thread may run its own compilation.
+    static thread_local CompileContext* sInstance;
 
     static inline CompileContext& get() { return *sInstance; }
     static inline CompileContext* maybe_get() { return sInstance; }
@@ -63,6 +65,20 @@ class CompileContext final
     void TrackMalloc(size_t bytes);
     void TrackFree(size_t bytes);
 
+    // Frees everything in phase_allocator(). This is called when a compiler
+    // phase is done with its scratch data.
+    void ReleasePhaseMemory();
+
+    // Malloc and pool memory held right now. memory_peak() is the most that was
+    // ever held at once, and memory_watermark() is the most that was held since
+    // the last call to ResetMemoryWatermark().
+    size_t memory_in_use() const {
+        return malloc_bytes_ + allocator_.reserved() + phase_allocator_.reserved();
+    }
+    size_t memory_peak() const { return std::max(memory_peak_, memory_in_use()); }
+    size_t memory_watermark() const { return std::max(memory_watermark_, memory_in_use()); }
+    void ResetMemoryWatermark() { memory_watermark_ = memory_in_use(); }
+
     SymbolScope* globals() const { return globals_; }
     tr::unordered_set<FunctionDecl*>& functions() { return functions_; }
     tr::unordered_set<FunctionDecl*>& publics() { return publics_; }
@@ -105,6 +121,11 @@ class CompileContext final
     std::string& outfname() { return outfname_; }
     void set_outfname(const std::string& value) { outfname_ = value; }
 
+    // If set, the --time-phases-json report is stored here instead of being
+    // written out, so that a batch compile can write every job's at once.
+    std::string* phase_report() const { return phase_report_; }
+    void set_phase_report(std::string* report) { phase_report_ = report; }
+
     std::shared_ptr<SourceFile> inpf_org() const { return inpf_org_; }
     void set_inpf_org(std::shared_ptr<SourceFile> sf) { inpf_org_ = sf; }
 
@@ -119,6 +140,10 @@ class CompileContext final
 
     cc::PoolAllocator& allocator() { return allocator_; }
 
+    // Scratch memory that only lives until the current phase ends. Anything
+    // that outlives the phase, like the AST, must use allocator() instead.
+    cc::PoolAllocator& phase_allocator() { return phase_allocator_; }
+
     // No copy construction.
     CompileContext(const CompileContext&) = delete;
     CompileContext(CompileContext&&) = delete;
@@ -129,8 +154,12 @@ class CompileContext final
     tr::vector<tr::string>* NewDebugStringList();
     tr::unordered_map<Atom*, Decl*>* NewSymbolMap();
 
+  private:
+    void SampleMemory();
+
   private:
     cc::PoolAllocator allocator_;
+    cc::PoolAllocator phase_allocator_;
     SymbolScope* globals_;
     std::string default_include_;
     tr::unordered_set<FunctionDecl*> functions_;
@@ -138,6 +167,7 @@ class CompileContext final
     std::unique_ptr<CompileOptions> options_;
     std::string outfname_;
     std::string errfname_;
+    std::string* phase_report_ = nullptr;
     std::unique_ptr<SourceManager> sources_;
     std::shared_ptr<SourceFile> inpf_org_;
     std::unique_ptr<TypeManager> types_;
@@ -167,6 +197,8 @@ class CompileContext final
 
     size_t malloc_bytes_ = 0;
     size_t malloc_bytes_peak_ = 0;
+    size_t memory_peak_ = 0;
+    size_t memory_watermark_ = 0;
 
     bool in_preprocessor_ = false;
     bool detected_illegal_preproc_symbols_ = false;
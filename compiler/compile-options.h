@@ -41,6 +41,11 @@ struct CompileOptions {
     int compression = 9;
     bool show_includes = false;
     bool syntax_only = false;
+    bool inline_functions = true;
+    bool hoist_loop_loads = true;
+    bool fuse_instructions = true;
+    bool parse_unused_stocks = false;
+    unsigned int verify_threads = 0;   /* 0 = one per CPU */
     int verbosity = 1;             /* verbosity level, 0=quiet, 1=normal, 2=verbose */
     std::vector<std::pair<std::string, std::string>> predefines;
 };
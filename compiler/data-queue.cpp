@@ -50,6 +50,15 @@ DataQueue::DataQueue()
 void
 DataQueue::Add(cell value)
 {
+    if (!value) {
+        pending_zeroes_++;
+        return;
+    }
+
+    if (pending_zeroes_) {
+        buffer_.resize(buffer_.size() + pending_zeroes_, 0);
+        pending_zeroes_ = 0;
+    }
     buffer_.emplace_back(value);
 }
 
@@ -57,7 +66,7 @@ void
 DataQueue::Add(const char* text, size_t length)
 {
     StringToCells(text, length, [this](cell value) -> void {
-        buffer_.emplace_back(value);
+        Add(value);
     });
 }
 
@@ -68,14 +77,81 @@ DataQueue::Add(tr::vector<cell>&& cells)
         return;
 
     for (const auto& value : cells)
-        buffer_.emplace_back(value);
+        Add(value);
     cells.clear();
 }
 
 void
 DataQueue::AddZeroes(cell count)
 {
-    buffer_.resize(buffer_.size() + count, 0);
+    pending_zeroes_ += count;
+}
+
+cell
+DataQueue::AddZeroFilled(cell bytes)
+{
+    assert(!zero_filled_placed_);
+    assert(bytes % sizeof(cell) == 0);
+
+    cell offset = zero_filled_size_;
+    zero_filled_size_ += bytes;
+    return offset;
+}
+
+void
+DataQueue::AddZeroFilledAddress(cell offset)
+{
+    assert(!zero_filled_placed_);
+
+    // The cell is patched later, so it must be materialized even if the
+    // offset is zero.
+    if (pending_zeroes_) {
+        buffer_.resize(buffer_.size() + pending_zeroes_, 0);
+        pending_zeroes_ = 0;
+    }
+    zero_filled_relocs_.emplace_back(buffer_.size());
+    buffer_.emplace_back(offset);
+}
+
+cell
+DataQueue::PlaceZeroFilled()
+{
+    assert(!zero_filled_placed_);
+    zero_filled_placed_ = true;
+
+    cell base = dat_address();
+    for (const auto& index : zero_filled_relocs_)
+        buffer_[index] += base;
+    return base;
+}
+
+cell
+DataQueue::Intern(tr::vector<cell>&& cells)
+{
+    assert(!cells.empty());
+
+    auto iter = pool_.find(cells);
+    if (iter != pool_.end()) {
+        merged_size_ += (cell)(cells.size() * sizeof(cell));
+        cells.clear();
+        return iter->second;
+    }
+
+    cell addr = dat_address();
+    for (const auto& value : cells)
+        Add(value);
+    pool_.emplace(std::move(cells), addr);
+    return addr;
+}
+
+cell
+DataQueue::Intern(const char* text, size_t length)
+{
+    tr::vector<cell> cells;
+    StringToCells(text, length, [&cells](cell value) -> void {
+        cells.emplace_back(value);
+    });
+    return Intern(std::move(cells));
 }
 
 } // namespace sp
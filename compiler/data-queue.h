@@ -19,6 +19,8 @@
 //  3.  This notice may not be removed or altered from any source distribution.
 #pragma once
 
+#include <amtl/am-hashutil.h>
+
 #include "sc.h"
 #include "symbols.h"
 
@@ -34,12 +36,50 @@ class DataQueue final
     void Add(const char* text, size_t length);
     void AddZeroes(cell count);
 
-    cell size() const { return (cell)buffer_.size() * sizeof(cell); }
-    cell dat_address() const { return (cell)buffer_.size() * sizeof(cell); }
+    // Add a run of read-only data, returning its address. Identical runs are
+    // only emitted once, so the caller must never write through the address.
+    cell Intern(tr::vector<cell>&& cells);
+    cell Intern(const char* text, size_t length);
+
+    // Reserve zero-filled storage, returning its offset into the zero-filled
+    // region. The region is placed after everything else in the queue, so its
+    // addresses are only known once PlaceZeroFilled() is called.
+    cell AddZeroFilled(cell bytes);
+
+    // Add a cell holding the address at |offset| in the zero-filled region.
+    void AddZeroFilledAddress(cell offset);
+
+    // Place the zero-filled region after all other data, patch every cell
+    // added by AddZeroFilledAddress(), and return the region's address.
+    cell PlaceZeroFilled();
+
+    cell size() const { return dat_address() + zero_filled_size_; }
+    cell dat_address() const { return ((cell)buffer_.size() + pending_zeroes_) * sizeof(cell); }
+
+    // Trailing zeroes, including the zero-filled region, are not materialized;
+    // dat() holds only the first initialized_size() bytes, and the rest of the
+    // queue is zero.
     const uint8_t* dat() const { return reinterpret_cast<const uint8_t*>(buffer_.data()); }
+    cell initialized_size() const { return (cell)buffer_.size() * sizeof(cell); }
+
+    // Bytes that Intern() did not have to emit thanks to an earlier copy.
+    cell merged_size() const { return merged_size_; }
 
   private:
+    struct CellRunHash {
+        size_t operator()(const tr::vector<cell>& run) const {
+            return ke::HashCharSequence(reinterpret_cast<const char*>(run.data()),
+                                        run.size() * sizeof(cell));
+        }
+    };
+
     tr::vector<cell> buffer_;
+    cell pending_zeroes_ = 0;
+    cell merged_size_ = 0;
+    cell zero_filled_size_ = 0;
+    bool zero_filled_placed_ = false;
+    tr::vector<size_t> zero_filled_relocs_;
+    tr::unordered_map<tr::vector<cell>, cell, CellRunHash> pool_;
 };
 
 } // namespace sp
@@ -19,15 +19,29 @@
 //  3.  This notice may not be removed or altered from any source distribution.
 #include <amtl/experimental/am-argparser.h>
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "compile-options.h"
 #include "errors.h"
 #include "sc.h"
+#include "source-file.h"
 
 #if defined _WIN32
 # include <Windows.h>
 # include <direct.h>
+# include <fcntl.h>
+# include <io.h>
+# include <process.h>
 #else
 # include <unistd.h>
 #endif
@@ -72,6 +86,23 @@ args::ToggleOption opt_stderr(nullptr, "--use-stderr", Some(false),
                               "Use stderr instead of stdout for error messages.");
 args::ToggleOption opt_no_verify(nullptr, "--no-verify", Some(false),
                                  "Disable opcode verification (for debugging).");
+args::ToggleOption opt_no_inline(nullptr, "--no-inline", Some(false),
+                                 "Do not inline calls to small functions.");
+args::ToggleOption opt_no_hoist(nullptr, "--no-loop-hoist", Some(false),
+                                "Do not hoist loop-invariant sub-array loads out of loops.");
+args::ToggleOption opt_no_fuse(nullptr, "--no-fuse", Some(false),
+                               "Do not fuse instruction sequences into superinstructions.");
+args::ToggleOption opt_check_stocks(nullptr, "--check-unused-stocks", Some(false),
+                                    "Parse and check stocks that are never referenced.");
+args::IntOption opt_jobs("-j", "--jobs", Some(0),
+                         "Number of files to compile in parallel (default: one per CPU)");
+args::ToggleOption opt_server(nullptr, "--server", Some(false),
+                              "Run as a compile server, reading requests from stdin.");
+
+// Source files and macro definitions from the command line.
+static std::vector<std::string> sExtraArgs;
+
+static void applyoptions(CompileContext& cc);
 
 /* set_extension
  * Set the default extension, or force an extension. To erase the
@@ -115,6 +146,64 @@ static void parseoptions(CompileContext& cc, int argc, char** argv) {
         Usage(cc, parser, argc, argv);
     }
 
+    if (opt_active_dir.hasValue()) {
+        const char* ptr = opt_active_dir.value().c_str();
+#if defined dos_setdrive
+        if (ptr[1] == ':')
+            dos_setdrive(toupper(*ptr) - 'A' + 1); /* set active drive */
+#endif
+            if (chdir(ptr)) {
+                fprintf(stderr, "chdir failed: %s\n", strerror(errno));
+                exit(1);
+            }
+    }
+
+#if defined __WIN32__ || defined _WIN32 || defined _Windows
+    if (opt_hwnd.hasValue()) {
+        hwndFinish = (HWND)atoi(opt_hwnd.value().c_str());
+        if (!IsWindow(hwndFinish))
+            hwndFinish = (HWND)0;
+    }
+#endif
+
+    for (const auto& option : parser.extra_args()) {
+        if (option[0] == '@') {
+            fprintf(stderr, "Response files (@ prefix) are no longer supported.");
+            exit(1);
+        }
+        sExtraArgs.emplace_back(option);
+    }
+
+    applyoptions(cc);
+
+    if (cc.options()->source_files.empty() && !opt_server.value())
+        Usage(cc, parser, argc, argv);
+
+    if ((cc.options()->source_files.size() > 1 || opt_server.value()) &&
+        opt_error_file.hasValue())
+    {
+        fprintf(stderr, "--error-file cannot be used with --server or multiple source files.\n");
+        exit(1);
+    }
+
+    // The server's replies are written to stdout, so reports that are printed
+    // there would corrupt them.
+    if (opt_server.value()) {
+        const char* option = GetStdoutReportOption();
+        if (opt_showincludes.value())
+            option = "--show-includes";
+        else if (opt_verbosity.hasValue())
+            option = "--verbose";
+        if (option) {
+            fprintf(stderr, "%s cannot be used with --server.\n", option);
+            exit(1);
+        }
+    }
+}
+
+// Apply the parsed command line to a compile context. This is separate from
+// parsing so that each job in a batch compile gets its own copy.
+static void applyoptions(CompileContext& cc) {
     cc.options()->syntax_only = opt_syntax_only.value();
     cc.options()->need_semicolon = opt_semicolons.value();
     cc.options()->tabsize = opt_tabsize.value();
@@ -122,6 +211,10 @@ static void parseoptions(CompileContext& cc, int argc, char** argv) {
     cc.options()->use_stderr = opt_stderr.value();
     cc.options()->compression = opt_compression.value();
     cc.options()->show_includes = opt_showincludes.value();
+    cc.options()->inline_functions = !opt_no_inline.value();
+    cc.options()->hoist_loop_loads = !opt_no_hoist.value();
+    cc.options()->fuse_instructions = !opt_no_fuse.value();
+    cc.options()->parse_unused_stocks = opt_check_stocks.value();
 
     if (opt_no_verify.value())
         cc.set_verify_output(false);
@@ -139,29 +232,9 @@ static void parseoptions(CompileContext& cc, int argc, char** argv) {
             cc.options()->verbosity = 2;
     }
 
-    if (opt_active_dir.hasValue()) {
-        const char* ptr = opt_active_dir.value().c_str();
-#if defined dos_setdrive
-        if (ptr[1] == ':')
-            dos_setdrive(toupper(*ptr) - 'A' + 1); /* set active drive */
-#endif
-            if (chdir(ptr)) {
-                fprintf(stderr, "chdir failed: %s\n", strerror(errno));
-                exit(1);
-            }
-    }
-
     if (opt_error_file.hasValue())
         cc.set_errfname(opt_error_file.value());
 
-#if defined __WIN32__ || defined _WIN32 || defined _Windows
-    if (opt_hwnd.hasValue()) {
-        hwndFinish = (HWND)atoi(opt_hwnd.value().c_str());
-        if (!IsWindow(hwndFinish))
-            hwndFinish = (HWND)0;
-    }
-#endif
-
     for (const auto& inc_path : opt_includes.values()) {
         std::string str = inc_path;
 
@@ -182,12 +255,9 @@ static void parseoptions(CompileContext& cc, int argc, char** argv) {
             cc.reports()->EnableWarning(i, 2);
     }
 
-    for (const auto& option : parser.extra_args()) {
+    for (const auto& option : sExtraArgs) {
         size_t pos;
-        if (option[0] == '@') {
-            fprintf(stderr, "Response files (@ prefix) are no longer supported.");
-            exit(1);
-        } else if ((pos = option.find('=')) != std::string::npos) {
+        if ((pos = option.find('=')) != std::string::npos) {
             std::string key = option.substr(0, pos);
             std::string value = option.substr(pos + 1);
             cc.options()->predefines.emplace_back(std::move(key), std::move(value));
@@ -204,18 +274,308 @@ static void parseoptions(CompileContext& cc, int argc, char** argv) {
             }
         }
     }
+}
 
-    if (cc.options()->source_files.empty())
-        Usage(cc, parser, argc, argv);
+// When compiling more than one file, --output names a directory. Only the
+// file name is kept, so RunBatch rejects inputs whose names collide.
+static fs::path GetJobOutputPath(const std::string& file) {
+    fs::path out_path = fs::path(file).filename();
+    out_path.replace_extension(".smx");
+    if (opt_outputfile.hasValue())
+        out_path = fs::path(opt_outputfile.value()) / out_path;
+    return out_path;
 }
 
+// Compile each source file in its own CompileContext on a pool of threads.
+// Files are read from disk once and shared between jobs.
+static int RunBatch(int argc, char** argv, const std::vector<std::string>& files) {
+    unsigned int num_threads = opt_jobs.value() > 0 ? opt_jobs.value()
+                                                    : std::thread::hardware_concurrency();
+    num_threads = std::max(1u, std::min(num_threads, (unsigned int)files.size()));
+
+    std::unordered_map<std::string, std::string> outputs;
+    for (const auto& file : files) {
+        auto out_path = GetJobOutputPath(file).string();
+        auto iter = outputs.find(out_path);
+        if (iter != outputs.end()) {
+            fprintf(stderr, "%s and %s would both be compiled to %s.\n", iter->second.c_str(),
+                    file.c_str(), out_path.c_str());
+            return 1;
+        }
+        outputs.emplace(out_path, file);
+    }
+
+    // Jobs run in parallel, so each keeps its --time-phases-json report until
+    // they have all finished.
+    std::vector<std::string> reports(files.size());
+
+    std::mutex lock;
+    size_t next_file = 0;
+    int failed = 0;
+
+    auto worker = [&]() -> void {
+        for (;;) {
+            size_t index;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (next_file >= files.size())
+                    return;
+                index = next_file++;
+            }
+
+            const auto& file = files[index];
+            auto start = std::chrono::steady_clock::now();
+
+            int rv;
+            {
+                CompileContext cc;
+                applyoptions(cc);
+
+                cc.set_outfname(GetJobOutputPath(file).string());
+                cc.set_phase_report(&reports[index]);
+                cc.options()->source_files = {file};
+
+                // Jobs already keep every CPU busy.
+                if (num_threads > 1)
+                    cc.options()->verify_threads = 1;
+                rv = RunCompiler(argc, argv, cc);
+            }
+
+            auto end = std::chrono::steady_clock::now();
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+            std::lock_guard<std::mutex> guard(lock);
+            if (rv != 0)
+                failed++;
+            printf("%s: %s in %lld ms\n", file.c_str(), rv == 0 ? "compiled" : "failed",
+                   (long long)ms.count());
+            fflush(stdout);
+        }
+    };
+
+    // Note that the main thread has its own CompileContext, so it can't run
+    // jobs itself.
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < num_threads; i++)
+        threads.emplace_back(worker);
+    for (auto& thread : threads)
+        thread.join();
+
+    WritePhaseReports(reports);
+
+    if (failed)
+        printf("\n%d of %zu files failed to compile.\n", failed, files.size());
+    return failed ? 1 : 0;
+}
+
+// A file a compiled plugin depended on, as of its last compile. The stamp is
+// taken when the compiler opened the file, before its contents were read.
+struct Dependency {
+    std::string path;
+    FileStamp stamp;
+    size_t hash;
+};
+
+struct ServerResult {
+    bool ok = false;
+    std::string diagnostics;
+    std::string smx;
+    std::vector<Dependency> deps;
+    std::vector<std::string> missing;
+};
+
+static bool ReadWholeFile(const std::string& path, std::string* out) {
+    std::ifstream fp(path, std::ios::binary);
+    if (!fp)
+        return false;
+    std::ostringstream ss;
+    ss << fp.rdbuf();
+    *out = ss.str();
+    return true;
+}
+
+// A dependency is unchanged if its stamp proves it (see FileStamp::Proves).
+// Otherwise, if the size still matches, the contents are hashed before
+// deciding: the mtime may have moved without an edit (a touch, or an editor
+// rewriting the file), or may not have moved past a same-tick edit.
+static bool IsUnchanged(Dependency* dep) {
+    FileStamp now;
+    if (!FileStamp::Get(dep->path, &now))
+        return false;
+    if (now.size != dep->stamp.size)
+        return false;
+    if (dep->stamp.Proves(now))
+        return true;
+
+    std::string contents;
+    if (!ReadWholeFile(dep->path, &contents))
+        return false;
+    if (std::hash<std::string>()(contents) != dep->hash)
+        return false;
+    dep->stamp = now;
+    return true;
+}
+
+// An #include probe that failed must still fail, or the new file may shadow
+// one that the last compile used.
+static bool IsStillMissing(const std::string& path) {
+    FileStamp stamp;
+    return !FileStamp::Get(path, &stamp);
+}
+
+static void CompileForServer(int argc, char** argv, const std::string& file,
+                             const std::string& diag_path, ServerResult* result)
+{
+    CompileContext cc;
+    applyoptions(cc);
+
+    auto out_path = GetJobOutputPath(file).string();
+    cc.set_outfname(out_path);
+    cc.set_errfname(diag_path);
+    cc.options()->source_files = {file};
+    cc.options()->show_includes = false;
+
+    result->ok = RunCompiler(argc, argv, cc) == 0;
+
+    for (const auto& sf : cc.sources()->opened_files()) {
+        if (sf->is_builtin())
+            continue;
+        std::string contents(reinterpret_cast<const char*>(sf->data()), sf->size());
+        result->deps.emplace_back(
+            Dependency{sf->path(), sf->stamp(), std::hash<std::string>()(contents)});
+    }
+
+    std::unordered_set<std::string> seen;
+    for (const auto& path : cc.sources()->missing_files()) {
+        if (seen.emplace(path).second)
+            result->missing.emplace_back(path);
+    }
+
+    ReadWholeFile(diag_path, &result->diagnostics);
+    remove(diag_path.c_str());
+
+    if (result->ok && !ReadWholeFile(out_path, &result->smx))
+        result->ok = false;
+}
+
+// Long-running compile server. Requests are read from stdin, one per line:
+//
+//   compile <file>    Compile a plugin, unless nothing it includes has changed.
+//   quit              Exit.
+//
+// Each compile is answered with a header line followed by two payloads:
+//
+//   result <ok|failed|unchanged> <ms> <diagnostic-bytes> <smx-bytes>
+//
+// File contents stay cached between requests, keyed by path and validated by
+// size, nanosecond mtime and, when the mtime is too recent to trust, contents.
+// Include paths that were probed and not found are re-checked too.
+//
+// Anything else the compiler prints goes to stderr, so that stdout only ever
+// carries replies.
+// Parsed include trees are not kept, since they belong to a single
+// CompileContext.
+static int RunServer(int argc, char** argv) {
+#if defined _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+    FILE* out = _fdopen(_dup(_fileno(stdout)), "wb");
+    if (out)
+        _dup2(_fileno(stderr), _fileno(stdout));
+#else
+    FILE* out = fdopen(dup(fileno(stdout)), "wb");
+    if (out)
+        dup2(fileno(stderr), fileno(stdout));
+#endif
+    if (!out) {
+        fprintf(stderr, "Could not redirect stdout: %s\n", strerror(errno));
+        return 1;
+    }
+
+#if defined _WIN32
+    int pid = _getpid();
+#else
+    int pid = getpid();
+#endif
+
+    std::unordered_map<std::string, ServerResult> results;
+    unsigned int jobs = 0;
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == '\n'))
+            line.pop_back();
+        if (line.empty())
+            continue;
+        if (line == "quit")
+            break;
+        if (line.compare(0, 8, "compile ") != 0) {
+            fprintf(out, "error unknown request\n");
+            fflush(out);
+            continue;
+        }
+
+        std::string file = line.substr(8);
+        auto start = std::chrono::steady_clock::now();
+
+        const char* status;
+        auto iter = results.find(file);
+        if (iter != results.end() && iter->second.ok &&
+            std::all_of(iter->second.deps.begin(), iter->second.deps.end(), IsUnchanged) &&
+            std::all_of(iter->second.missing.begin(), iter->second.missing.end(),
+                        IsStillMissing))
+        {
+            status = "unchanged";
+        } else {
+            ServerResult result;
+
+            // Diagnostics go through a file; name it per process and per job so
+            // that concurrent servers never share one.
+            auto diag_name = "spcomp-server-" + std::to_string(pid) + "-" +
+                             std::to_string(jobs++) + ".txt";
+            auto diag_path = (fs::temp_directory_path() / diag_name).string();
+
+            // CompileContext is per-thread, and this thread already has one.
+            std::thread worker(CompileForServer, argc, argv, file, diag_path, &result);
+            worker.join();
+
+            status = result.ok ? "ok" : "failed";
+            iter = results.insert_or_assign(file, std::move(result)).first;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+        const auto& result = iter->second;
+        fprintf(out, "result %s %lld %zu %zu\n", status, (long long)ms.count(),
+                result.diagnostics.size(), result.smx.size());
+        fwrite(result.diagnostics.data(), 1, result.diagnostics.size(), out);
+        fwrite(result.smx.data(), 1, result.smx.size(), out);
+        fflush(out);
+    }
+    fclose(out);
+    return 0;
+}
 
 int main(int argc, char** argv) {
     CompileContext cc;
 
     parseoptions(cc, argc, argv);
 
-    int rv = RunCompiler(argc, argv, cc);
+    if (opt_server.value()) {
+        SourceFile::EnableSharedCache();
+        return RunServer(argc, argv);
+    }
+
+    if (cc.errfname().empty() && cc.options()->verbosity > 0)
+        setcaption();
+
+    int rv;
+    if (cc.options()->source_files.size() > 1) {
+        SourceFile::EnableSharedCache();
+        rv = RunBatch(argc, argv, cc.options()->source_files);
+    } else {
+        rv = RunCompiler(argc, argv, cc);
+    }
 
 #if defined __WIN32__ || defined _WIN32 || defined _Windows
     if (IsWindow(hwndFinish))
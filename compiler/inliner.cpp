@@ -0,0 +1,385 @@
+// vim: set ts=8 sts=4 sw=4 tw=99 et:
+//
+//  Copyright (c) AlliedModders LLC 2021
+//
+//  This software is provided "as-is", without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1.  The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software in
+//      a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//  2.  Altered source versions must be plainly marked as such, and must not be
+//      misrepresented as being the original software.
+//  3.  This notice may not be removed or altered from any source distribution.
+#include "inliner.h"
+
+#include <algorithm>
+
+#include <amtl/am-raii.h>
+#include "compile-options.h"
+#include "expressions.h"
+#include "sc.h"
+
+namespace sp {
+
+// Maximum number of expression nodes in the body of an inlined function.
+static const int kMaxInlineNodes = 16;
+
+// Maximum number of arguments to an inlined function.
+static const size_t kMaxInlineArgs = 4;
+
+Inliner::Inliner(CompileContext& cc)
+  : cc_(cc)
+{
+}
+
+void Inliner::Run(ParseTree* tree) {
+    if (!cc_.options()->inline_functions)
+        return;
+
+    FindCandidates(tree->stmts());
+    if (candidates_.empty())
+        return;
+
+    FindCallSites(tree->stmts());
+
+    // A callee that is never referenced except by direct calls has no use
+    // for an out-of-line body once every one of those calls is inlined.
+    for (FunctionDecl* fun : candidates_) {
+        if (!fun->is_callback() && !fun->has_outline_calls())
+            fun->clear_is_live();
+    }
+}
+
+// Inlined bodies may only read their arguments and globals, and may not make
+// calls. This means nothing can re-enter the body while it runs, and the
+// arguments never need their own stack frame.
+static bool
+IsInlineableExpr(FunctionDecl* fun, Expr* expr, int* budget)
+{
+    if (--*budget < 0)
+        return false;
+    if (expr->val().ident == iCONSTEXPR)
+        return true;
+
+    switch (expr->kind()) {
+        case ExprKind::RvalueExpr:
+            return IsInlineableExpr(fun, expr->to<RvalueExpr>()->expr(), budget);
+        case ExprKind::CastExpr:
+            return IsInlineableExpr(fun, expr->to<CastExpr>()->expr(), budget);
+        case ExprKind::SymbolExpr: {
+            auto var = expr->to<SymbolExpr>()->decl()->as<VarDeclBase>();
+            if (!var)
+                return false;
+            if (var->vclass() == sGLOBAL || var->vclass() == sSTATIC)
+                return true;
+            if (var->vclass() != sARGUMENT)
+                return false;
+            for (const auto& arg : fun->args()) {
+                if (arg == var)
+                    return true;
+            }
+            return false;
+        }
+        case ExprKind::UnaryExpr: {
+            auto e = expr->to<UnaryExpr>();
+            return !e->userop() && IsInlineableExpr(fun, e->expr(), budget);
+        }
+        case ExprKind::BinaryExpr: {
+            auto e = expr->to<BinaryExpr>();
+            if (IsAssignOp(e->token()) || e->userop().sym)
+                return false;
+            return IsInlineableExpr(fun, e->left(), budget) &&
+                   IsInlineableExpr(fun, e->right(), budget);
+        }
+        case ExprKind::LogicalExpr: {
+            auto e = expr->to<LogicalExpr>();
+            return IsInlineableExpr(fun, e->left(), budget) &&
+                   IsInlineableExpr(fun, e->right(), budget);
+        }
+        case ExprKind::ChainedCompareExpr: {
+            auto e = expr->to<ChainedCompareExpr>();
+            if (!IsInlineableExpr(fun, e->first(), budget))
+                return false;
+            for (const auto& op : e->ops()) {
+                if (op.userop.sym || !IsInlineableExpr(fun, op.expr, budget))
+                    return false;
+            }
+            return true;
+        }
+        case ExprKind::TernaryExpr: {
+            auto e = expr->to<TernaryExpr>();
+            return IsInlineableExpr(fun, e->first(), budget) &&
+                   IsInlineableExpr(fun, e->second(), budget) &&
+                   IsInlineableExpr(fun, e->third(), budget);
+        }
+        case ExprKind::IndexExpr: {
+            auto e = expr->to<IndexExpr>();
+            return IsInlineableExpr(fun, e->base(), budget) &&
+                   IsInlineableExpr(fun, e->index(), budget);
+        }
+        default:
+            return false;
+    }
+}
+
+static ReturnStmt*
+GetInlineReturn(FunctionDecl* fun)
+{
+    StmtList* body = fun->body()->as<BlockStmt>();
+    if (!body)
+        body = fun->body()->as<StmtList>();
+    if (!body || body->stmts().size() != 1)
+        return nullptr;
+    return body->stmts()[0]->as<ReturnStmt>();
+}
+
+// Only plain functions are considered. Methods and property accessors can be
+// invoked without a CallExpr, and so can operators, so their calls can't all
+// be found.
+void Inliner::FindCandidates(Stmt* stmt) {
+    if (auto list = stmt->as<StmtList>()) {
+        for (const auto& child : list->stmts())
+            FindCandidates(child);
+        return;
+    }
+    if (stmt->kind() != StmtKind::FunctionDecl)
+        return;
+
+    auto fun = stmt->to<FunctionDecl>();
+    if (fun->canonical() != fun || !CanInline(fun))
+        return;
+
+    fun->set_inline_return(GetInlineReturn(fun));
+    candidates_.emplace_back(fun);
+}
+
+bool Inliner::CanInline(FunctionDecl* fun) {
+    if (!fun->is_live() || fun->is_native() || fun->is_public() || !fun->body())
+        return false;
+    if (fun->return_array() || fun->decl().opertok)
+        return false;
+    if (fun->args().size() > kMaxInlineArgs)
+        return false;
+    for (const auto& arg : fun->args()) {
+        if (arg->type_info().ident != iVARIABLE)
+            return false;
+    }
+
+    auto ret = GetInlineReturn(fun);
+    if (!ret || !ret->expr() || ret->expr()->tree_has_heap_allocs())
+        return false;
+
+    const auto& val = ret->expr()->val();
+    if (val.ident == iARRAY || val.ident == iREFARRAY)
+        return false;
+
+    int budget = kMaxInlineNodes;
+    return IsInlineableExpr(fun, ret->expr(), &budget);
+}
+
+void Inliner::FindCallSites(Stmt* stmt) {
+    switch (stmt->kind()) {
+        case StmtKind::StmtList:
+            for (const auto& child : stmt->to<StmtList>()->stmts())
+                FindCallSites(child);
+            break;
+        case StmtKind::FunctionDecl:
+        case StmtKind::MemberFunctionDecl:
+        case StmtKind::MethodmapMethodDecl:
+            VisitFunction(stmt->to<FunctionDecl>());
+            break;
+        case StmtKind::EnumStructDecl:
+            for (const auto& fun : stmt->to<EnumStructDecl>()->methods())
+                VisitFunction(fun);
+            break;
+        case StmtKind::MethodmapDecl: {
+            auto decl = stmt->to<MethodmapDecl>();
+            for (const auto& prop : decl->properties()) {
+                if (prop->getter())
+                    VisitFunction(prop->getter());
+                if (prop->setter())
+                    VisitFunction(prop->setter());
+            }
+            for (const auto& method : decl->methods())
+                VisitFunction(method);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void Inliner::VisitFunction(FunctionDecl* fun) {
+    if (!fun->is_live() || !fun->body())
+        return;
+
+    ke::SaveAndSet<FunctionDecl*> set_caller(&caller_, fun);
+    Visit(fun->body());
+}
+
+void Inliner::Visit(Stmt* stmt) {
+    switch (stmt->kind()) {
+        case StmtKind::StmtList:
+            VisitList(stmt->to<StmtList>()->stmts());
+            break;
+        case StmtKind::BlockStmt:
+            VisitList(stmt->to<BlockStmt>()->stmts());
+            break;
+        case StmtKind::ExprStmt:
+            Visit(stmt->to<ExprStmt>()->expr());
+            break;
+        case StmtKind::ReturnStmt:
+            if (auto expr = stmt->to<ReturnStmt>()->expr())
+                Visit(expr);
+            break;
+        case StmtKind::AssertStmt:
+            Visit(stmt->to<AssertStmt>()->expr());
+            break;
+        case StmtKind::DeleteStmt:
+            Visit(stmt->to<DeleteStmt>()->expr());
+            break;
+        case StmtKind::ExitStmt:
+            if (auto expr = stmt->to<ExitStmt>()->expr())
+                Visit(expr);
+            break;
+        case StmtKind::IfStmt: {
+            auto s = stmt->to<IfStmt>();
+            Visit(s->cond());
+            Visit(s->on_true());
+            if (s->on_false())
+                Visit(s->on_false());
+            break;
+        }
+        case StmtKind::DoWhileStmt: {
+            auto s = stmt->to<DoWhileStmt>();
+            Visit(s->cond());
+            Visit(s->body());
+            break;
+        }
+        case StmtKind::ForStmt: {
+            auto s = stmt->to<ForStmt>();
+            if (s->init())
+                Visit(s->init());
+            if (s->cond())
+                Visit(s->cond());
+            if (s->advance())
+                Visit(s->advance());
+            Visit(s->body());
+            break;
+        }
+        case StmtKind::SwitchStmt: {
+            auto s = stmt->to<SwitchStmt>();
+            Visit(s->expr());
+            for (const auto& entry : s->cases())
+                Visit(entry.second);
+            if (s->default_case())
+                Visit(s->default_case());
+            break;
+        }
+        case StmtKind::VarDecl:
+            if (auto init = stmt->to<VarDecl>()->init())
+                Visit(init);
+            break;
+        default:
+            break;
+    }
+}
+
+void Inliner::Visit(Expr* expr) {
+    switch (expr->kind()) {
+        case ExprKind::UnaryExpr:
+            Visit(expr->to<UnaryExpr>()->expr());
+            break;
+        case ExprKind::BinaryExpr: {
+            auto e = expr->to<BinaryExpr>();
+            Visit(e->left());
+            Visit(e->right());
+            break;
+        }
+        case ExprKind::LogicalExpr: {
+            auto e = expr->to<LogicalExpr>();
+            Visit(e->left());
+            Visit(e->right());
+            break;
+        }
+        case ExprKind::ChainedCompareExpr: {
+            auto e = expr->to<ChainedCompareExpr>();
+            Visit(e->first());
+            for (const auto& op : e->ops())
+                Visit(op.expr);
+            break;
+        }
+        case ExprKind::TernaryExpr: {
+            auto e = expr->to<TernaryExpr>();
+            Visit(e->first());
+            Visit(e->second());
+            Visit(e->third());
+            break;
+        }
+        case ExprKind::IncDecExpr:
+            Visit(expr->to<IncDecExpr>()->expr());
+            break;
+        case ExprKind::CastExpr:
+            Visit(expr->to<CastExpr>()->expr());
+            break;
+        case ExprKind::CallExpr:
+            VisitCall(expr->to<CallExpr>());
+            break;
+        case ExprKind::NamedArgExpr:
+            Visit(expr->to<NamedArgExpr>()->expr);
+            break;
+        case ExprKind::CallUserOpExpr:
+            Visit(expr->to<CallUserOpExpr>()->expr());
+            break;
+        case ExprKind::FieldAccessExpr:
+            Visit(expr->to<FieldAccessExpr>()->base());
+            break;
+        case ExprKind::IndexExpr: {
+            auto e = expr->to<IndexExpr>();
+            Visit(e->base());
+            Visit(e->index());
+            break;
+        }
+        case ExprKind::RvalueExpr:
+            Visit(expr->to<RvalueExpr>()->expr());
+            break;
+        case ExprKind::CommaExpr:
+            VisitList(expr->to<CommaExpr>()->exprs());
+            break;
+        case ExprKind::NewArrayExpr:
+            VisitList(expr->to<NewArrayExpr>()->exprs());
+            break;
+        case ExprKind::ArrayExpr:
+            VisitList(expr->to<ArrayExpr>()->exprs());
+            break;
+        default:
+            break;
+    }
+}
+
+void Inliner::VisitCall(CallExpr* call) {
+    if (call->implicit_this())
+        Visit(call->implicit_this());
+    VisitList(call->args());
+
+    auto fun = call->fun() ? call->fun()->impl() : nullptr;
+    if (!fun || !fun->inline_return())
+        return;
+
+    if (call->val().sym || call->args().size() != fun->args().size()) {
+        fun->set_has_outline_calls();
+        return;
+    }
+
+    call->set_is_inlined();
+    caller_->set_inline_slots(std::max(caller_->inline_slots(), (int)fun->args().size()));
+}
+
+} // namespace sp
@@ -0,0 +1,68 @@
+// vim: set ts=8 sts=4 sw=4 tw=99 et:
+//
+//  Copyright (c) AlliedModders LLC 2021
+//
+//  This software is provided "as-is", without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1.  The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software in
+//      a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//  2.  Altered source versions must be plainly marked as such, and must not be
+//      misrepresented as being the original software.
+//  3.  This notice may not be removed or altered from any source distribution.
+#pragma once
+
+#include "compile-context.h"
+#include "parse-node.h"
+
+namespace sp {
+
+// Runs after semantic analysis and chooses which calls the code generator
+// emits in place. Only small non-public functions whose body is a single
+// "return <expr>;" are inlined, and only when that expression reads nothing
+// but its by-value arguments, globals and constants.
+//
+// The pass does not change the tree's shape. It records its decisions on the
+// nodes:
+//  - FunctionDecl::inline_return(): the callee's body, for inlined callees.
+//  - CallExpr::is_inlined(): the call site is emitted in place.
+//  - FunctionDecl::inline_slots(): frame cells the caller reserves for the
+//    arguments of its inlined calls.
+// Callees that are only ever called directly lose their liveness, so no
+// out-of-line body is emitted for them.
+class Inliner final
+{
+  public:
+    explicit Inliner(CompileContext& cc);
+
+    void Run(ParseTree* tree);
+
+  private:
+    void FindCandidates(Stmt* stmt);
+    void FindCallSites(Stmt* stmt);
+    bool CanInline(FunctionDecl* fun);
+    void VisitFunction(FunctionDecl* fun);
+    void Visit(Stmt* stmt);
+    void Visit(Expr* expr);
+    void VisitCall(CallExpr* call);
+
+    template <typename T>
+    void VisitList(PoolArray<T*>& nodes) {
+        for (const auto& node : nodes)
+            Visit(node);
+    }
+
+  private:
+    CompileContext& cc_;
+    PhaseList<FunctionDecl*> candidates_;
+    FunctionDecl* caller_ = nullptr;
+};
+
+} // namespace sp
@@ -0,0 +1,126 @@
+// vim: set ts=8 sts=4 sw=4 tw=99 et:
+//
+//  Copyright (c) AlliedModders LLC 2021
+//
+//  This software is provided "as-is", without any express or implied warranty.
+//  In no event will the authors be held liable for any damages arising from
+//  the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions:
+//
+//  1.  The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software in
+//      a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//  2.  Altered source versions must be plainly marked as such, and must not be
+//      misrepresented as being the original software.
+//  3.  This notice may not be removed or altered from any source distribution.
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define SP_LEXER_SCAN_SSE2
+# include <emmintrin.h>
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# endif
+#endif
+
+namespace sp {
+
+// Block scanners for the lexer's byte-at-a-time loops. FindAnyOf returns the
+// first position in [pos, end) holding one of |Bytes|, and SkipAllOf returns
+// the first position holding anything else. Both return |end| if there is no
+// such position. With SSE2 they look at 16 bytes per step and never read past
+// |end|.
+namespace scan {
+
+#if defined(SP_LEXER_SCAN_SSE2)
+static inline int MatchMask(__m128i) {
+    return 0;
+}
+
+template <typename... Rest>
+static inline int MatchMask(__m128i block, unsigned char first, Rest... rest) {
+    __m128i eq = _mm_cmpeq_epi8(block, _mm_set1_epi8(static_cast<char>(first)));
+    return _mm_movemask_epi8(eq) | MatchMask(block, rest...);
+}
+
+static inline unsigned int LowestBit(unsigned int mask) {
+# if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+# else
+    return __builtin_ctz(mask);
+# endif
+}
+#endif
+
+static inline bool IsOneOf(unsigned char) {
+    return false;
+}
+
+template <typename... Rest>
+static inline bool IsOneOf(unsigned char c, unsigned char first, Rest... rest) {
+    return c == first || IsOneOf(c, rest...);
+}
+
+} // namespace scan
+
+template <unsigned char... Bytes>
+static inline const unsigned char* FindAnyOf(const unsigned char* pos, const unsigned char* end) {
+#if defined(SP_LEXER_SCAN_SSE2)
+    while (end - pos >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        if (int mask = scan::MatchMask(block, Bytes...))
+            return pos + scan::LowestBit(mask);
+        pos += 16;
+    }
+#endif
+    while (pos < end && !scan::IsOneOf(*pos, Bytes...))
+        pos++;
+    return pos;
+}
+
+template <unsigned char... Bytes>
+static inline const unsigned char* SkipAllOf(const unsigned char* pos, const unsigned char* end) {
+#if defined(SP_LEXER_SCAN_SSE2)
+    while (end - pos >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        if (int mask = scan::MatchMask(block, Bytes...) ^ 0xffff)
+            return pos + scan::LowestBit(mask);
+        pos += 16;
+    }
+#endif
+    while (pos < end && scan::IsOneOf(*pos, Bytes...))
+        pos++;
+    return pos;
+}
+
+// Returns the first position in [pos, end) that ends a run of plain string
+// literal text: |term|, the escape character, a backslash, a newline, NUL, or
+// a non-ASCII byte.
+static inline const unsigned char* FindStringBreak(const unsigned char* pos,
+                                                   const unsigned char* end,
+                                                   unsigned char term, unsigned char ctrl)
+{
+#if defined(SP_LEXER_SCAN_SSE2)
+    while (end - pos >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        int mask = scan::MatchMask(block, term, ctrl, '\\', '\r', '\n', '\0') |
+                   _mm_movemask_epi8(block);
+        if (mask)
+            return pos + scan::LowestBit(mask);
+        pos += 16;
+    }
+#endif
+    while (pos < end && *pos < 0x80 && !scan::IsOneOf(*pos, term, ctrl, '\\', '\r', '\n', '\0'))
+        pos++;
+    return pos;
+}
+
+} // namespace sp
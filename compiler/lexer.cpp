@@ -30,6 +30,7 @@
 #include <string.h>
 
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <unordered_set>
 #include <utility>
@@ -52,6 +53,7 @@
 #include "errors.h"
 #include "lexer.h"
 #include "lexer-inl.h"
+#include "lexer-scan.h"
 #include "parser.h"
 #include "sc.h"
 #include "sci18n.h"
@@ -561,12 +563,12 @@ void Lexer::HandleDirectives() {
             break;
         }
         case tpERROR: {
-            auto str = SkimUntilEndOfLine();
+            const auto& str = SkimUntilEndOfLine();
             report(416) << str;
             break;
         }
         case tpWARNING: {
-            auto str = SkimUntilEndOfLine();
+            const auto& str = SkimUntilEndOfLine();
             report(224) << str;
             break;
         }
@@ -586,6 +588,17 @@ void Lexer::HandleDirectives() {
 void Lexer::HandleSkippedSection() {
     // Eat stuff until we reach a new directive.
     while (more()) {
+        // Only newlines, comments, and directives matter here, so skip other
+        // text in bulk. A directive must start its line, so remember whether
+        // anything but whitespace was skipped.
+        auto next = FindAnyOf<'\r', '\n', '/', '#', '\0'>(state_.pos, state_.end);
+        if (next != state_.pos) {
+            if (SkipAllOf<' ', '\t', '\v', '\f'>(state_.pos, next) != next)
+                tokens_on_line_++;
+            state_.pos = next;
+            continue;
+        }
+
         char c = peek();
         if (IsNewline(c)) {
             HandleNewline(c, '\0');
@@ -671,12 +684,7 @@ void Lexer::HandleSkippedSection() {
 }
 
 void Lexer::SkipLineWhitespace() {
-    while (true) {
-        char c = peek();
-        if (!IsSpace(c) || IsNewline(c))
-            break;
-        advance();
-    }
+    state_.pos = SkipAllOf<' ', '\t', '\v', '\f'>(state_.pos, state_.end);
 }
 
 static inline void AddText(std::string* text, const unsigned char** start,
@@ -684,14 +692,15 @@ static inline void AddText(std::string* text, const unsigned char** start,
 {
     if (!*start)
         return;
-    *text += std::string((const char *)*start, (const char *)end);
+    text->append((const char*)*start, (const char*)end);
     if (extra != '\0' && !text->empty() && text->back() != extra)
         text->push_back(extra);
     *start = nullptr;
 }
 
-std::string Lexer::SkimUntilEndOfLine(tr::vector<size_t>* macro_args) {
-    std::string text;
+const std::string& Lexer::SkimUntilEndOfLine(tr::vector<size_t>* macro_args) {
+    std::string& text = skimmed_line_;
+    text.clear();
 
     const unsigned char* start = nullptr;
     while (true) {
@@ -773,17 +782,8 @@ bool Lexer::FindNextToken() {
         auto work_line = line_start();
         bool is_line_start = (work_line == work_start) && !IsInMacro();
 
-        // Skip whitespace.
-        while (true) {
-            char c = peek();
-            if (!IsSpace(c))
-                break;
-
-            if (c == '\r' || c == '\n')
-                break;
-
-            advance();
-        }
+        // Skip whitespace, stopping at newlines.
+        state_.pos = SkipAllOf<' ', '\t', '\v', '\f'>(state_.pos, state_.end);
 
         char c = peek();
         switch (c) {
@@ -944,18 +944,17 @@ void Lexer::HandleSingleLineComment() {
     assert(c == '/');
     (void)c;
 
-    char prev_c = c;
-    while (true) {
-        char c = peek();
-        if (c == '\0' || IsNewline(c)) {
-            if (prev_c == '\\')
-                report(49); // invalid line continuation
-            break;
-        }
-        if (!IsSpace(c))
-            prev_c = c;
-        advance();
-    }
+    // Only the last non-space character matters, since a trailing backslash
+    // would look like a line continuation.
+    auto eol = FindAnyOf<'\r', '\n', '\0'>(state_.pos, state_.end);
+    auto last = eol;
+    while (last > state_.pos && IsSpace(static_cast<char>(last[-1])))
+        last--;
+
+    char prev_c = (last > state_.pos) ? static_cast<char>(last[-1]) : c;
+    if (prev_c == '\\')
+        report(49); // invalid line continuation
+    state_.pos = eol;
 }
 
 void Lexer::HandleMultiLineComment() {
@@ -967,6 +966,8 @@ void Lexer::HandleMultiLineComment() {
     (void)c;
 
     while (true) {
+        state_.pos = FindAnyOf<'*', '/', '\r', '\n', '\0'>(state_.pos, state_.end);
+
         if (match_char('*')) {
             if (match_char('/'))
                 return;
@@ -997,6 +998,12 @@ void Lexer::HandleMultiLineComment() {
 void Lexer::packedstring(full_token_t* tok, char term) {
     std::string data;
     while (true) {
+        // Plain ASCII needs no escape or UTF-8 handling, so copy it in bulk.
+        auto run_end = FindStringBreak(state_.pos, state_.end, static_cast<unsigned char>(term),
+                                       static_cast<unsigned char>(ctrlchar_));
+        data.append(reinterpret_cast<const char*>(state_.pos), run_end - state_.pos);
+        state_.pos = run_end;
+
         char c = peek();
         if (c == term || c == 0)
             break;
@@ -1227,11 +1234,7 @@ Lexer::Lexer(CompileContext& cc)
 }
 
 Lexer::~Lexer() {
-    while (!token_caches_.empty()) {
-        auto node = *token_caches_.begin();
-        token_caches_.remove(node);
-        delete node;
-    }
+    DiscardTokenCaches();
 }
 
 void Lexer::AddFile(std::shared_ptr<SourceFile> sf) {
@@ -1363,7 +1366,7 @@ int Lexer::lex() {
     }
 
     if (using_injected_tokens_) {
-        if (!injected_token_stream_.empty())
+        if (injected_pos_ != injected_end_)
             return LexInjectedToken();
         return 0;
     }
@@ -1373,7 +1376,7 @@ int Lexer::lex() {
 
 bool Lexer::freading() const {
     if (using_injected_tokens_)
-        return !injected_token_stream_.empty();
+        return injected_pos_ != injected_end_;
     return freading_;
 }
 
@@ -1424,12 +1427,12 @@ int Lexer::LexNewToken() {
 
 int Lexer::LexInjectedToken() {
     auto tok = advance_token_ptr();
-    *tok = ke::PopFront(&injected_token_stream_);
+    *tok = *injected_pos_++;
 
     if (tok->id == tMAYBE_LABEL) {
         if (allow_tags_) {
             tok->id = tLABEL;
-            [[maybe_unused]] auto tok = ke::PopFront(&injected_token_stream_);
+            [[maybe_unused]] const auto& tok = *injected_pos_++;
             assert(tok.id == ':');
         } else {
             tok->id = tSYMBOL;
@@ -2439,25 +2442,28 @@ bool Lexer::EnterMacro(std::shared_ptr<MacroEntry> macro) {
     if (macros_in_use_.count(macro.get()))
         return false;
 
-    std::unordered_map<int, std::string> macro_args;
+    MacroArgs macro_args;
     if (macro->args) {
         if (!match('('))
             return false;
 
         auto saved_pos = pos();
 
+        size_t nargs = 0;
         for (const auto& argn : macro->args.get()) {
-            auto arg_str = SkimMacroArgument();
+            size_t start = macro_args.text.size();
+            SkimMacroArgument(&macro_args.text);
             if (argn != macro->args.get().back()) {
                 if (!need(','))
                     break;
             }
-            macro_args.emplace(argn, std::move(arg_str));
+            if (macro_args.add(argn, start))
+                nargs++;
         }
         need(')');
 
-        if (macro_args.size() != macro->args.get().size()) {
-            report(saved_pos, 429) << macro->args.get().size() << macro_args.size();
+        if (nargs != macro->args.get().size()) {
+            report(saved_pos, 429) << macro->args.get().size() << nargs;
             return false;
         }
     }
@@ -2473,7 +2479,7 @@ bool Lexer::EnterMacro(std::shared_ptr<MacroEntry> macro) {
         //
         // We used to not atomize here, in which case it was stored on the
         // lexer state.
-        text = cc_.atom(PerformMacroSubstitution(macro.get(), macro_args));
+        text = PerformMacroSubstitution(macro.get(), macro_args);
     } else {
         text = macro->substitute;
     }
@@ -2500,9 +2506,7 @@ bool Lexer::EnterMacro(std::shared_ptr<MacroEntry> macro) {
     return true;
 }
 
-std::string Lexer::SkimMacroArgument() {
-    std::string text;
-
+void Lexer::SkimMacroArgument(std::string* text) {
     const unsigned char* start = nullptr;
     int nparens = 0;
     while (freading()) {
@@ -2510,21 +2514,21 @@ std::string Lexer::SkimMacroArgument() {
         if (c == '\0')
             break;
         if (c == '/' && peek2() == '/') {
-            AddText(&text, &start, char_stream(), ' ');
+            AddText(text, &start, char_stream(), ' ');
             HandleSingleLineComment();
             continue;
         } else if (c == '/' && peek2() == '*') {
-            AddText(&text, &start, char_stream(), ' ');
+            AddText(text, &start, char_stream(), ' ');
             HandleMultiLineComment();
             continue;
         } else if (IsNewline(c)) {
             HandleNewline(c, '\0');
-            AddText(&text, &start, char_stream(), ' ');
+            AddText(text, &start, char_stream(), ' ');
             continue;
         } else if (c == '\\') {
             auto end = char_stream();
             if (MaybeHandleLineContinuation()) {
-                AddText(&text, &start, end, ' ');
+                AddText(text, &start, end, ' ');
                 continue;
             }
         } else if (c == '(') {
@@ -2543,14 +2547,14 @@ std::string Lexer::SkimMacroArgument() {
         advance();
     }
 
-    AddText(&text, &start, char_stream(), '\0');
-    return text;
+    AddText(text, &start, char_stream(), '\0');
 }
 
-std::string Lexer::PerformMacroSubstitution(MacroEntry* macro,
-                                            const std::unordered_map<int, std::string>& args)
-{
-    std::string out;
+Atom* Lexer::PerformMacroSubstitution(MacroEntry* macro, const MacroArgs& args) {
+    // The expansion buffer is reused across macros; only the atomized result
+    // needs to outlive this call.
+    std::string& out = macro_expansion_;
+    out.clear();
 
     size_t last_start = 0;
     const auto& substitute = macro->substitute->str();
@@ -2569,24 +2573,24 @@ std::string Lexer::PerformMacroSubstitution(MacroEntry* macro,
             stringize = true;
         }
 
-        out += substitute.substr(last_start, last_end - last_start);
+        out.append(substitute, last_start, last_end - last_start);
         last_start = pos + 2;
 
-        char arg_pos = substitute[pos + 1] - '0';
-        auto iter = args.find(arg_pos);
-        if (iter == args.end()) {
+        int arg_pos = substitute[pos + 1] - '0';
+        if (!args.present[arg_pos]) {
             out.push_back(substitute[pos]);
             out.push_back(substitute[pos + 1]);
             continue;
         }
         if (stringize)
-            out += '"' + iter->second + '"';
-        else
-            out += iter->second;
+            out.push_back('"');
+        out.append(args.text, args.offsets[arg_pos], args.lengths[arg_pos]);
+        if (stringize)
+            out.push_back('"');
     }
 
-    out += substitute.substr(last_start);
-    return out;
+    out.append(substitute, last_start, std::string::npos);
+    return cc_.atom(out);
 }
 
 void Lexer::SkipUtf8Bom() {
@@ -2607,12 +2611,13 @@ void Lexer::AssertCleanState() {
     assert(allow_substitutions_);
     assert(!in_string_continuation_);
     assert(allow_tags_);
-    assert(injected_token_stream_.empty());
+    assert(injected_pos_ == injected_end_);
     assert(!using_injected_tokens_);
 }
 
 TokenCache* Lexer::LexFunctionBody() {
-    TokenCache* cache = new TokenCache;
+    auto& alloc = cc_.phase_allocator();
+    TokenCache* cache = new (alloc.alloc<TokenCache>()) TokenCache;
     cache->require_newdecls = state_.require_newdecls;
     cache->need_semicolon = state_.need_semicolon;
 
@@ -2621,7 +2626,8 @@ TokenCache* Lexer::LexFunctionBody() {
     AssertCleanState();
 
     assert(current_token()->id == '{');
-    cache->tokens.emplace_back(std::move(*current_token()));
+    body_tokens_.clear();
+    body_tokens_.emplace_back(*current_token());
 
     ke::SaveAndSet<bool> caching_tokens(&caching_tokens_, true);
 
@@ -2630,7 +2636,7 @@ TokenCache* Lexer::LexFunctionBody() {
         int tok = lex();
         if (tok == 0)
             break;
-        cache->tokens.emplace_back(std::move(*current_token()));
+        body_tokens_.emplace_back(*current_token());
 
         if (tok == '{') {
             brace_balance++;
@@ -2641,7 +2647,9 @@ TokenCache* Lexer::LexFunctionBody() {
         }
     }
 
-    cache->tokens.shrink_to_fit();
+    cache->num_tokens = body_tokens_.size();
+    cache->tokens = alloc.alloc<full_token_t>(cache->num_tokens);
+    std::uninitialized_copy(body_tokens_.begin(), body_tokens_.end(), cache->tokens);
     token_caches_.append(cache);
     return cache;
 }
@@ -2649,17 +2657,29 @@ TokenCache* Lexer::LexFunctionBody() {
 void Lexer::InjectCachedTokens(TokenCache* cache) {
     AssertCleanState();
 
-    injected_token_stream_ = std::move(cache->tokens);
+    // The tokens stay in the phase allocator until parsing is done.
+    injected_pos_ = cache->tokens;
+    injected_end_ = cache->tokens + cache->num_tokens;
     using_injected_tokens_ = true;
     token_caches_.remove(cache);
-    delete cache;
 
     freading_ = true;
 }
 
+void Lexer::DiscardTokenCache(TokenCache* cache) {
+    token_caches_.remove(cache);
+}
+
+void Lexer::DiscardTokenCaches() {
+    while (!token_caches_.empty())
+        token_caches_.remove(*token_caches_.begin());
+    DiscardCachedTokens();
+}
+
 void Lexer::DiscardCachedTokens() {
     using_injected_tokens_ = false;
-    injected_token_stream_.clear();
+    injected_pos_ = nullptr;
+    injected_end_ = nullptr;
 }
 
 } // namespace sp
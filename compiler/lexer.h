@@ -284,8 +284,11 @@ static constexpr int SKIPMODE = 1;     /* bit field in "#if" stack */
 static constexpr int PARSEMODE = 2;    /* bit field in "#if" stack */
 static constexpr int HANDLED_ELSE = 4; /* bit field in "#if" stack */
 
+// Token caches live in the phase allocator, and are freed once every function
+// body has been parsed.
 struct TokenCache : public ke::InlineListNode<TokenCache> {
-    std::deque<full_token_t> tokens;
+    full_token_t* tokens;
+    size_t num_tokens;
     bool require_newdecls;
     bool need_semicolon;
 };
@@ -332,10 +335,16 @@ class Lexer
     // stream. This is to avoid significantly changing parse_stmt.
     TokenCache* LexFunctionBody();
 
-    // Consumes a TokenCache. The pointer is deleted after. Consumed tokens will
-    // be replayed by lex().
+    // Consumes a TokenCache. The pointer must not be used after. Consumed tokens
+    // will be replayed by lex().
     void InjectCachedTokens(TokenCache* cache);
 
+    // Drop a TokenCache without injecting it.
+    void DiscardTokenCache(TokenCache* cache);
+
+    // Drop every TokenCache, so that the phase allocator can be released.
+    void DiscardTokenCaches();
+
     // Throw away tokens injected by InjectCachedTokens().
     void DiscardCachedTokens();
 
@@ -384,8 +393,8 @@ class Lexer
     void EnterFile(std::shared_ptr<SourceFile>&& fp, const token_pos_t& from);
     void FillTokenPos(token_pos_t* pos);
     void SkipLineWhitespace();
-    std::string SkimUntilEndOfLine(tr::vector<size_t>* macro_args = nullptr);
-    std::string SkimMacroArgument();
+    const std::string& SkimUntilEndOfLine(tr::vector<size_t>* macro_args = nullptr);
+    void SkimMacroArgument(std::string* text);
     void CheckLineEmpty(bool allow_semi = false);
     void NeedTokenError(int expected, int got);
     void SkipUtf8Bom();
@@ -459,13 +468,32 @@ class Lexer
         token_pos_t pos;
         bool deprecated;
     };
+    // Arguments to a function-like macro. All of them are skimmed into one
+    // buffer, and %0 through %9 each refer to a range of it.
+    struct MacroArgs {
+        static constexpr size_t kMaxArgs = 10;
+
+        bool add(int argn, size_t start) {
+            if (present[argn])
+                return false;
+            present[argn] = true;
+            offsets[argn] = start;
+            lengths[argn] = text.size() - start;
+            return true;
+        }
+
+        std::string text;
+        size_t offsets[kMaxArgs];
+        size_t lengths[kMaxArgs];
+        bool present[kMaxArgs] = {};
+    };
+
     std::shared_ptr<MacroEntry> FindMacro(Atom* atom);
     void AddMacro(const char* pattern, const char* subst);
     bool DeleteMacro(Atom* atom);
     bool EnterMacro(std::shared_ptr<MacroEntry> macro);
     bool IsInMacro() const { return state_.macro != nullptr; }
-    std::string PerformMacroSubstitution(MacroEntry* macro,
-                                         const std::unordered_map<int, std::string>& args);
+    Atom* PerformMacroSubstitution(MacroEntry* macro, const MacroArgs& args);
 
   private:
     CompileContext& cc_;
@@ -491,6 +519,10 @@ class Lexer
 
     tr::unordered_map<Atom*, std::shared_ptr<MacroEntry>> macros_;
     std::unordered_set<MacroEntry*> macros_in_use_;
+    std::string macro_expansion_;
+
+    // Reused by SkimUntilEndOfLine.
+    std::string skimmed_line_;
 
     struct LexerState {
         LexerState() {}
@@ -528,7 +560,12 @@ class Lexer
     bool caching_tokens_ = false;
     ke::InlineList<TokenCache> token_caches_;
 
-    std::deque<full_token_t> injected_token_stream_;
+    // Scratch space for LexFunctionBody, which copies the final tokens into
+    // the phase allocator.
+    tr::vector<full_token_t> body_tokens_;
+
+    const full_token_t* injected_pos_ = nullptr;
+    const full_token_t* injected_end_ = nullptr;
     bool using_injected_tokens_ = false;
 };
 
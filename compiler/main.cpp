@@ -30,10 +30,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <amtl/am-platform.h>
 #include <amtl/am-raii.h>
@@ -45,6 +48,7 @@
 #include "assembler.h"
 #include "code-generator.h"
 #include "compile-options.h"
+#include "inliner.h"
 #include "lexer.h"
 #include "lexer-inl.h"
 #include "parser.h"
@@ -102,6 +106,180 @@ enum {
 
 args::ToggleOption opt_show_stats(nullptr, "--show-stats", Some(false),
                                   "Show compiler statistics on exit.");
+args::ToggleOption opt_time_phases(nullptr, "--time-phases", Some(false),
+                                   "Show the time and memory used by each compiler phase.");
+args::StringOption opt_time_phases_json(nullptr, "--time-phases-json", {},
+                                        "Write the phase timing report to a file as JSON.");
+
+// Records wall time, pool growth, and peak memory for each compiler phase.
+// Lexing and preprocessing happen on demand, so they are counted as part of
+// parsing.
+class PhaseTimer
+{
+  public:
+    explicit PhaseTimer(CompileContext& cc)
+      : cc_(cc)
+    {}
+
+    void Start(const char* name) {
+        Stop();
+        current_ = name;
+        start_ = std::chrono::steady_clock::now();
+        start_pool_ = PoolBytes();
+        cc_.ResetMemoryWatermark();
+    }
+
+    void Stop() {
+        if (!current_)
+            return;
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        phases_.emplace_back(Phase{current_,
+                                   std::chrono::duration<double, std::milli>(elapsed).count(),
+                                   PoolBytes() - start_pool_, cc_.memory_watermark()});
+        current_ = nullptr;
+    }
+
+    void Print(const CodeGenerator& cg);
+    std::string ToJson(const CodeGenerator& cg);
+
+  private:
+    size_t PoolBytes() const {
+        size_t allocated, reserved, bookkeeping;
+        cc_.allocator().memoryUsage(&allocated, &reserved, &bookkeeping);
+        return allocated;
+    }
+
+  private:
+    struct Phase {
+        const char* name;
+        double ms;
+        size_t pool_bytes;
+        size_t peak_bytes;
+    };
+
+    CompileContext& cc_;
+    std::vector<Phase> phases_;
+    const char* current_ = nullptr;
+    std::chrono::steady_clock::time_point start_;
+    size_t start_pool_ = 0;
+};
+
+void PhaseTimer::Print(const CodeGenerator& cg) {
+    printf("\n");
+    printf(" -- Compiler phases --\n");
+    double total = 0;
+    for (const auto& phase : phases_) {
+        printf("%-18s %10.3f ms %10" KE_FMT_SIZET " pool bytes %10" KE_FMT_SIZET " peak bytes\n",
+               phase.name, phase.ms, phase.pool_bytes, phase.peak_bytes);
+        total += phase.ms;
+    }
+    printf("%-18s %10.3f ms %10s %10" KE_FMT_SIZET " peak bytes\n", "total", total, "",
+           cc_.memory_peak());
+
+    std::vector<const CodeGenerator::FunctionStats*> largest;
+    for (const auto& stats : cg.function_stats())
+        largest.emplace_back(&stats);
+    std::sort(largest.begin(), largest.end(), [](const auto* a, const auto* b) {
+        return a->code_size > b->code_size;
+    });
+    if (largest.size() > 10)
+        largest.resize(10);
+
+    if (largest.empty())
+        return;
+
+    printf("\n");
+    printf(" -- Largest functions --\n");
+    for (const auto* stats : largest) {
+        printf("%-32s %8" PRIu32 " bytes %8" PRIu32 " instructions\n",
+               stats->decl->name()->chars(), stats->code_size, stats->instructions);
+    }
+}
+
+static std::string JsonString(const std::string& str) {
+    std::string out = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '\t') {
+            out += "\\t";
+        } else if ((unsigned char)c < 0x20) {
+            out += ke::StringPrintf("\\u%04x", (unsigned char)c);
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+    return out;
+}
+
+std::string PhaseTimer::ToJson(const CodeGenerator& cg) {
+    std::string out;
+    out += ke::StringPrintf("{\n  \"file\": %s,\n  \"phases\": [",
+                            JsonString(cc_.options()->source_files[0]).c_str());
+    for (size_t i = 0; i < phases_.size(); i++) {
+        const auto& phase = phases_[i];
+        out += ke::StringPrintf("%s\n    {\"name\": \"%s\", \"ms\": %.3f, \"pool_bytes\": %"
+                                KE_FMT_SIZET ", \"peak_bytes\": %" KE_FMT_SIZET "}",
+                                i ? "," : "", phase.name, phase.ms, phase.pool_bytes,
+                                phase.peak_bytes);
+    }
+    out += ke::StringPrintf("\n  ],\n  \"peak_bytes\": %" KE_FMT_SIZET ",\n  \"functions\": [",
+                            cc_.memory_peak());
+
+    const auto& functions = cg.function_stats();
+    for (size_t i = 0; i < functions.size(); i++) {
+        const auto& stats = functions[i];
+        out += ke::StringPrintf("%s\n    {\"name\": %s, \"code_bytes\": %" PRIu32
+                                ", \"instructions\": %" PRIu32 "}",
+                                i ? "," : "", JsonString(stats.decl->name()->chars()).c_str(),
+                                stats.code_size, stats.instructions);
+    }
+    out += "\n  ]\n}";
+    return out;
+}
+
+static bool WriteTextFile(const std::string& path, const std::string& text) {
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+    ok &= fclose(fp) == 0;
+    return ok;
+}
+
+// Batch compiles collect one report per job and write them all at once, as a
+// JSON array in command-line order.
+void WritePhaseReports(const std::vector<std::string>& reports) {
+    if (!opt_time_phases_json.hasValue())
+        return;
+
+    std::string text = "[";
+    for (size_t i = 0; i < reports.size(); i++) {
+        if (reports[i].empty())
+            continue;
+        if (text.size() > 1)
+            text += ",";
+        text += "\n" + reports[i];
+    }
+    text += "\n]\n";
+
+    if (!WriteTextFile(opt_time_phases_json.value(), text))
+        fprintf(stderr, "Could not write %s\n", opt_time_phases_json.value().c_str());
+}
+
+// Returns the name of an enabled option whose report is printed to stdout, or
+// null if there is none.
+const char* GetStdoutReportOption() {
+    if (opt_show_stats.value())
+        return "--show-stats";
+    if (opt_time_phases.value())
+        return "--time-phases";
+    return nullptr;
+}
 
 #ifdef __EMSCRIPTEN__
 EM_JS(void, setup_emscripten_fs, (), {
@@ -118,6 +296,7 @@ int RunCompiler(int argc, char** argv, CompileContext& cc) {
     bool ok = false;
     std::string ext;
     BuiltinGenerator gen(cc);
+    PhaseTimer timer(cc);
 
     cc.CreateGlobalScope();
     cc.InitLexer();
@@ -130,10 +309,11 @@ int RunCompiler(int argc, char** argv, CompileContext& cc) {
 
     if (!cc.errfname().empty())
         remove(cc.errfname().c_str()); /* delete file on startup */
-    else if (options->verbosity > 0)
-        setcaption();
     setconfig(argv[0]); /* the path to the include files */
 
+    timer.Start("parse");
+
+    // Multiple files are compiled as separate jobs by the driver.
     assert(options->source_files.size() == 1);
     {
         auto sf = cc.sources()->Open({}, options->source_files[0]);
@@ -177,25 +357,36 @@ int RunCompiler(int argc, char** argv, CompileContext& cc) {
             SemaContext sc(&sema);
             sema.set_context(&sc);
 
+            timer.Start("enter names");
             if (!tree->stmts()->EnterNames(sc) || !errors.ok())
                 goto cleanup;
 
             errors.Reset();
+            timer.Start("bind");
             if (!tree->stmts()->Bind(sc) || !errors.ok())
                 goto cleanup;
 
             sema.set_context(nullptr);
 
             errors.Reset();
+            timer.Start("semantic analysis");
             if (!sema.Analyze(tree) || !errors.ok())
                 goto cleanup;
 
             tree->stmts()->ProcessUses(sc);
+
+            Inliner inliner(cc);
+            inliner.Run(tree);
             ok = true;
         }
     }
 
+    // Scratch data from semantic analysis is dead now.
+    cc.ReleasePhaseMemory();
+
 cleanup:
+    timer.Stop();
+
     if (!ok && cc.reports()->NumErrorMessages() == 0)
         report(423);
 
@@ -207,13 +398,17 @@ cleanup:
     cc.reports()->DumpErrorReport(true);
 
     CodeGenerator cg(cc, tree);
-    if (tree && compile_ok)
+    if (tree && compile_ok) {
+        timer.Start("code generation");
         compile_ok = cg.Generate();
+    }
 
     // Write the binary file.
     if (!options->syntax_only && compile_ok) {
+        timer.Start("assemble");
         compile_ok &= assemble(cc, cg, cc.outfname().c_str(), options->compression);
     }
+    timer.Stop();
 
     errnum += cc.reports()->NumErrorMessages();
     cc.reports()->DumpErrorReport(true);
@@ -228,6 +423,16 @@ cleanup:
 
     cc.set_inpf_org(nullptr);
 
+    if (opt_time_phases.value() && cc.errfname().empty())
+        timer.Print(cg);
+    if (opt_time_phases_json.hasValue()) {
+        std::string json = timer.ToJson(cg);
+        if (auto report = cc.phase_report())
+            *report = std::move(json);
+        else if (!WriteTextFile(opt_time_phases_json.value(), json + "\n"))
+            fprintf(stderr, "Could not write %s\n", opt_time_phases_json.value().c_str());
+    }
+
     if (compile_ok && cc.errfname().empty()) {
         if (options->verbosity >= 1 && compile_ok) {
             printf("Code size:         %" PRIu32 " bytes\n", cg.code_size());
@@ -249,6 +454,22 @@ cleanup:
             printf("Pool unused:       %8" KE_FMT_SIZET " bytes\n", reserved - allocated);
             printf("Pool bookkeeping:  %8" KE_FMT_SIZET " bytes\n", bookkeeping);
             printf("Pool wasted:       %8" KE_FMT_SIZET " bytes\n", cc.allocator().wasted());
+            printf("Phase pool peak:   %8" KE_FMT_SIZET " bytes\n",
+                   cc.phase_allocator().peak_reserved());
+            printf("Peak memory:       %8" KE_FMT_SIZET " bytes\n", cc.memory_peak());
+
+            printf("\n");
+            printf(" -- Code generation --\n");
+            printf("Code size:         %8" PRIu32 " bytes\n", cg.code_size());
+            printf("Instructions:      %8" PRIu32 "\n", cg.num_instructions());
+            printf("Fused:             %8" PRIu32 "\n", cg.num_fused_instructions());
+            printf("Data merged:       %8" PRIu32 " bytes\n", cg.data_merged_size());
+
+            printf("\n");
+            printf(" -- Dead code elimination --\n");
+            printf("Functions dropped: %8" PRIu32 "\n", cg.dead_functions());
+            printf("Globals dropped:   %8" PRIu32 "\n", cg.dead_globals());
+            printf("Data saved:        %8" PRIu32 " bytes\n", cg.dead_global_bytes());
         }
     }
 
@@ -328,4 +328,5 @@ static const char* errmsg_ex[] = {
     /*443*/ "enum %s already has a methodmap\n",
     /*444*/ "cannot find method \"%s.%s\"\n",
     /*445*/ "%s must be a field\n",
+    /*446*/ "internal compiler error: body of \"%s\" was not parsed, but the function is used\n",
 };
@@ -34,7 +34,9 @@ VarDeclBase::VarDeclBase(StmtKind kind, const token_pos_t& pos, Atom* name,
    is_stock_(is_stock),
    autozero_(true),
    is_read_(false),
-   is_written_(false)
+   is_written_(false),
+   is_live_(false),
+   is_zero_filled_(false)
 {
     // Having a BinaryExpr allows us to re-use assignment logic.
     if (initializer)
@@ -56,6 +58,18 @@ void VarDeclBase::BindAddress(cell addr) {
     addr_.bind(addr);
 }
 
+void VarDeclBase::BindZeroFilledAddress(cell offset) {
+    addr_.bind(offset);
+    is_zero_filled_ = true;
+}
+
+void VarDeclBase::RelocateZeroFilled(cell base) {
+    assert(is_zero_filled_);
+    cell offset = addr_.offset();
+    addr_.reset();
+    addr_.bind(base + offset);
+}
+
 void
 ParseNode::error(const token_pos_t& pos, int number)
 {
@@ -127,7 +141,9 @@ FunctionDecl::FunctionDecl(StmtKind kind, const token_pos_t& pos, const declinfo
     returns_value_(false),
     always_returns_(false),
     is_live_(false),
-    maybe_used_(false)
+    maybe_used_(false),
+    is_body_skipped_(false),
+    has_outline_calls_(false)
 {
 }
 
@@ -179,6 +195,20 @@ void FunctionDecl::AddReferenceTo(FunctionDecl* other) {
     refers_to_->emplace_front(other);
 }
 
+void FunctionDecl::AddGlobalReference(VarDeclBase* var) {
+    if (var->is_live())
+        return;
+    if (!refers_to_globals_) {
+        auto& cc = CompileContext::get();
+        refers_to_globals_ = cc.allocator().alloc<PoolForwardList<VarDeclBase*>>();
+    }
+    for (VarDeclBase* decl : *refers_to_globals_) {
+        if (decl == var)
+            return;
+    }
+    refers_to_globals_->emplace_front(var);
+}
+
 auto FunctionDecl::cg() -> CGInfo* {
     if (!cg_)
         cg_ = new CGInfo();
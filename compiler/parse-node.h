@@ -333,6 +333,13 @@ class VarDeclBase : public Decl
 
     void BindAddress(cell addr);
 
+    // Globals whose storage is entirely zero are placed after all other data,
+    // so the image only records how many zero bytes follow. Until code
+    // generation finishes, their address is an offset into that region.
+    void BindZeroFilledAddress(cell offset);
+    void RelocateZeroFilled(cell base);
+    bool is_zero_filled() const { return is_zero_filled_; }
+
     static bool is_a(Stmt* node) {
         return node->kind() == StmtKind::VarDecl ||
                node->kind() == StmtKind::ArgDecl ||
@@ -359,6 +366,11 @@ class VarDeclBase : public Decl
 
     bool is_used() const { return is_read_ || is_written_; }
 
+    // For globals: referenced from global scope or from a live function. Dead
+    // globals get no storage, debug symbol, or pubvar entry.
+    bool is_live() const { return is_live_; }
+    void set_is_live() { is_live_ = true; }
+
   protected:
     typeinfo_t type_;
     BinaryExpr* init_ = nullptr;
@@ -369,6 +381,8 @@ class VarDeclBase : public Decl
     bool autozero_ : 1;
     bool is_read_ : 1;
     bool is_written_ : 1;
+    bool is_live_ : 1;
+    bool is_zero_filled_ : 1;
     Label addr_;
 };
 
@@ -974,6 +988,10 @@ class CallExpr final : public Expr
     FunctionDecl* fun() const { return fun_; }
     void set_fun(FunctionDecl* fun) { fun_ = fun; }
 
+    // Set by the inliner when the callee's body is emitted in place.
+    bool is_inlined() const { return is_inlined_; }
+    void set_is_inlined() { is_inlined_ = true; }
+
   private:
     bool ProcessArg(SemaContext& sc, VarDecl* arg, Expr* param, unsigned int pos);
 
@@ -982,6 +1000,7 @@ class CallExpr final : public Expr
     PoolArray<Expr*> args_;
     FunctionDecl* fun_ = nullptr;
     Expr* implicit_this_ = nullptr;
+    bool is_inlined_ = false;
 };
 
 class EmitOnlyExpr : public Expr
@@ -1590,6 +1609,7 @@ class FunctionDecl : public Decl
     void ProcessUses(SemaContext& sc) override;
 
     void AddReferenceTo(FunctionDecl* other);
+    void AddGlobalReference(VarDeclBase* var);
 
     static bool is_a(Stmt* node) {
         return node->kind() == StmtKind::FunctionDecl ||
@@ -1677,9 +1697,28 @@ class FunctionDecl : public Decl
     void set_always_returns(bool value) { always_returns_ = value; }
     bool is_live() const { return is_live_; }
     void set_is_live() { is_live_ = true; }
+    void clear_is_live() { is_live_ = false; }
     bool maybe_used() const { return maybe_used_; }
     void set_maybe_used() { maybe_used_ = true; }
 
+    // Set by the inliner. Calls to this function are replaced by the
+    // expression of its only statement.
+    ReturnStmt* inline_return() const { return inline_return_; }
+    void set_inline_return(ReturnStmt* stmt) { inline_return_ = stmt; }
+
+    // Set by the inliner if a call to this function could not be inlined.
+    bool has_outline_calls() const { return has_outline_calls_; }
+    void set_has_outline_calls() { has_outline_calls_ = true; }
+
+    // Frame cells reserved for the arguments of calls inlined into this
+    // function.
+    int inline_slots() const { return inline_slots_; }
+    void set_inline_slots(int slots) { inline_slots_ = slots; }
+
+    // An unreferenced stock whose body was never parsed; body() is empty.
+    bool is_body_skipped() const { return is_body_skipped_; }
+    void set_is_body_skipped() { is_body_skipped_ = true; }
+
     void set_deprecate(const std::string& deprecate) { deprecate_ = new PoolString(deprecate); }
     const char* deprecate() const {
         return deprecate_ ? deprecate_->chars() : nullptr;
@@ -1705,6 +1744,9 @@ class FunctionDecl : public Decl
     const PoolForwardList<FunctionDecl*>* refers_to() const {
         return refers_to_;
     }
+    const PoolForwardList<VarDeclBase*>* refers_to_globals() const {
+        return refers_to_globals_;
+    }
 
     struct CGInfo : public PoolObject {
         tr::vector<tr::string>* dbgstrs = nullptr;
@@ -1732,9 +1774,12 @@ class FunctionDecl : public Decl
     TokenCache* tokens_ = nullptr;
     FunctionDecl* proto_or_impl_ = nullptr;
     ReturnArrayInfo* return_array_ = nullptr;
+    ReturnStmt* inline_return_ = nullptr;
+    int inline_slots_ = 0;
 
     // Other symbols that this symbol refers to.
     PoolForwardList<FunctionDecl*>* refers_to_ = nullptr;
+    PoolForwardList<VarDeclBase*>* refers_to_globals_ = nullptr;
 
     // Set during codegen.
     CGInfo* cg_ = nullptr;
@@ -1755,6 +1800,8 @@ class FunctionDecl : public Decl
     bool always_returns_ SP_BITFIELD(1); // whether all paths have an explicit return statement
     bool is_live_ SP_BITFIELD(1);        // must have code generated/linkage
     bool maybe_used_ SP_BITFIELD(1);     // not necessarily live, but do not warn if unused.
+    bool is_body_skipped_ SP_BITFIELD(1);
+    bool has_outline_calls_ SP_BITFIELD(1);
     bool checked_one_signature SP_BITFIELD(1);
     bool compared_prototype_args SP_BITFIELD(1);
 };
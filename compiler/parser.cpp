@@ -173,12 +173,37 @@ Parser::Parse()
         add_to_end.pop_front();
     }
 
+    ParseDelayedFunctions();
+
+    // Every function body has been parsed or skipped, so no cached tokens are
+    // needed anymore.
+    lexer_->DiscardTokenCaches();
+    cc_.ReleasePhaseMemory();
+
+    auto list = new StmtList(token_pos_t{}, stmts);
+    return new ParseTree(list);
+}
+
+void Parser::ParseDelayedFunctions() {
+    PhaseSet<FunctionDecl*> reachable;
+    FindReachableBodies(&reachable);
+
     while (!delayed_functions_.empty() && !cc_.must_abort()) {
         auto fun = ke::PopFront(&delayed_functions_);
 
         auto tokens = fun->tokens();
         fun->set_tokens(nullptr);
 
+        if (!reachable.count(fun)) {
+            // Nothing names this stock, so it can never be called. Give it an
+            // empty body so it still counts as implemented, and don't parse
+            // or analyze the real one.
+            lexer_->DiscardTokenCache(tokens);
+            fun->set_body(new BlockStmt(fun->end_pos(), {}));
+            fun->set_is_body_skipped();
+            continue;
+        }
+
         // Technically this is not good enough, as the lexer state could have
         // changed in the middle of a function. But that's fairly complex to
         // handle and pretty ridiculous as far as use cases go.
@@ -199,9 +224,43 @@ Parser::Parse()
 
         lexer_->DiscardCachedTokens();
     }
+}
 
-    auto list = new StmtList(token_pos_t{}, stmts);
-    return new ParseTree(list);
+// Stocks are only parsed if something that will be parsed mentions them by
+// name. Every other function body is a root. This is a token-level scan, so it
+// over-approximates: a field or local with the same name keeps a stock alive.
+void Parser::FindReachableBodies(PhaseSet<FunctionDecl*>* reachable) {
+    PhaseMap<Atom*, PhaseList<FunctionDecl*>> stocks;
+    PhaseList<FunctionDecl*> work;
+
+    for (const auto& fun : delayed_functions_) {
+        bool skippable = fun->is_stock() && fun->kind() == StmtKind::FunctionDecl &&
+                         !fun->decl().opertok;
+        if (skippable && !cc_.options()->parse_unused_stocks) {
+            stocks[fun->decl_name()].emplace_back(fun);
+        } else {
+            reachable->emplace(fun);
+            work.emplace_back(fun);
+        }
+    }
+
+    while (!work.empty() && !stocks.empty()) {
+        FunctionDecl* fun = ke::PopBack(&work);
+        TokenCache* cache = fun->tokens();
+        for (size_t i = 0; i < cache->num_tokens; i++) {
+            const auto& tok = cache->tokens[i];
+            if (tok.id != tSYMBOL)
+                continue;
+            auto iter = stocks.find(tok.atom);
+            if (iter == stocks.end())
+                continue;
+            for (const auto& stock : iter->second) {
+                reachable->emplace(stock);
+                work.emplace_back(stock);
+            }
+            stocks.erase(iter);
+        }
+    }
 }
 
 void Parser::ChangeStaticScope(std::vector<Stmt*>* stmts) {
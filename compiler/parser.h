@@ -47,6 +47,8 @@ class Parser
 
 
     void ChangeStaticScope(std::vector<Stmt*>* stmts);
+    void ParseDelayedFunctions();
+    void FindReachableBodies(PhaseSet<FunctionDecl*>* reachable);
 
     Stmt* parse_unknown_decl(const full_token_t* tok);
     Decl* parse_enum(int vclass);
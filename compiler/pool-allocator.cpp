@@ -19,6 +19,7 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <new>
 #include <utility>
 
@@ -47,8 +48,18 @@ PoolAllocator::ensurePool(size_t actualBytes)
     pool->ptr = pool->base.get();
     pool->end = pool->ptr + bytesNeeded;
     pools_.push_back(std::move(pool));
+
+    reserved_ += bytesNeeded;
+    peak_reserved_ = std::max(peak_reserved_, reserved_);
     return pools_.back().get();
 }
 
+void
+PoolAllocator::Release()
+{
+    pools_.clear();
+    reserved_ = 0;
+}
+
 } // namespace cc
 } // namespace sp
@@ -38,7 +38,8 @@ namespace sp {
 namespace cc {
 
 // Allocates memory in chunks that are not freed until the entire allocator
-// is freed. This is intended for use with large, temporary data structures.
+// is freed, or until Release() is called. This is intended for use with large,
+// temporary data structures.
 class PoolAllocator final
 {
     friend class PoolAllocationScope;
@@ -60,6 +61,8 @@ class PoolAllocator final
   private:
     std::vector<std::unique_ptr<Pool>> pools_;
     size_t wasted_ = 0;
+    size_t reserved_ = 0;
+    size_t peak_reserved_ = 0;
 
   private:
     Pool* ensurePool(size_t actualBytes);
@@ -95,6 +98,12 @@ class PoolAllocator final
     }
 
     size_t wasted() const { return wasted_; }
+    size_t reserved() const { return reserved_; }
+    size_t peak_reserved() const { return peak_reserved_; }
+
+    // Frees every pool at once. Nothing allocated from this allocator may be
+    // touched afterward, including by destructors.
+    void Release();
 
     template <typename T>
     T* alloc(size_t count = 1) {
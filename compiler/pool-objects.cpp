@@ -62,5 +62,22 @@ PoolAllocationPolicy::am_free(void* ptr)
 {
 }
 
+void*
+PhaseAllocationPolicy::Malloc(size_t bytes)
+{
+    auto& cc = CompileContext::get();
+    void* p = cc.phase_allocator().rawAllocate(bytes);
+    if (!p) {
+        fprintf(stderr, "OUT OF POOL MEMORY\n");
+        abort();
+    }
+    return p;
+}
+
+void PhaseAllocationPolicy::Free(size_t bytes) {
+    auto& cc = CompileContext::get();
+    cc.phase_allocator().trackFree(bytes);
+}
+
 } // namespace cc
 } // namespace sp
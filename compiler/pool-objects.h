@@ -18,6 +18,7 @@
 #pragma once
 
 #include <forward_list>
+#include <unordered_set>
 
 #include "compile-context.h"
 
@@ -89,7 +90,16 @@ class PoolAllocationPolicy
     static void Free(size_t bytes);
 };
 
-template <typename T>
+// Allocates from CompileContext::phase_allocator(). Containers using this must
+// be destroyed before the phase memory is released.
+class PhaseAllocationPolicy
+{
+  public:
+    static void* Malloc(size_t bytes);
+    static void Free(size_t bytes);
+};
+
+template <typename T, typename Policy = PoolAllocationPolicy>
 class StlPoolAllocator
 {
   public:
@@ -103,18 +113,18 @@ class StlPoolAllocator
     StlPoolAllocator(const StlPoolAllocator&) = default;
 
     template <typename U>
-    StlPoolAllocator(const StlPoolAllocator<U>& other) {}
+    StlPoolAllocator(const StlPoolAllocator<U, Policy>& other) {}
 
     template <typename U>
-    using rebind = StlPoolAllocator<U>;
+    using rebind = StlPoolAllocator<U, Policy>;
 
     static T* allocate(size_t n, const void* = nullptr) {
         if (!ke::IsUintMultiplySafe(n, sizeof(T)))
             throw std::bad_alloc{};
-        return reinterpret_cast<T*>(PoolAllocationPolicy::Malloc(n * sizeof(T)));
+        return reinterpret_cast<T*>(Policy::Malloc(n * sizeof(T)));
     }
     void deallocate(T* p, size_t n) {
-        PoolAllocationPolicy::Free(sizeof(T) * n);
+        Policy::Free(sizeof(T) * n);
     }
 
     bool operator ==(const StlPoolAllocator& other) const { return true; }
@@ -136,6 +146,24 @@ using PoolMap = std::unordered_map<Key, T, Hash, KeyEqual, StlPoolAllocator<std:
 template <typename T>
 using PoolForwardList = std::forward_list<T, StlPoolAllocator<T>>;
 
+// Scratch containers that die with the current compiler phase. Freed memory
+// is not reused, so these suit containers that live for most of a phase, not
+// short-lived temporaries.
+template <typename T>
+using PhaseList = std::vector<T, StlPoolAllocator<T, PhaseAllocationPolicy>>;
+
+template <typename T,
+          typename Hash = std::hash<T>,
+          typename KeyEqual = std::equal_to<T>>
+using PhaseSet = std::unordered_set<T, Hash, KeyEqual, StlPoolAllocator<T, PhaseAllocationPolicy>>;
+
+template <typename Key,
+          typename T,
+          typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+using PhaseMap = std::unordered_map<Key, T, Hash, KeyEqual,
+                                    StlPoolAllocator<std::pair<const Key, T>, PhaseAllocationPolicy>>;
+
 struct KeywordTablePolicy {
     static bool matches(const sp::CharsAndLength& a, const sp::CharsAndLength& b) {
         if (a.length() != b.length())
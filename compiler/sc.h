@@ -37,7 +37,9 @@
 #include <stdlib.h>
 
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <amtl/am-maybe.h>
 #include <amtl/am-vector.h>
@@ -104,6 +106,8 @@ const char* type_to_name(int tag);
 
 void setcaption();
 int RunCompiler(int argc, char** argv, CompileContext& cc);
+void WritePhaseReports(const std::vector<std::string>& reports);
+const char* GetStdoutReportOption();
 
 constexpr cell char_array_cells(cell size) {
     return (size + sizeof(cell) - 1) / sizeof(cell);
@@ -2477,7 +2477,7 @@ bool Semantics::TestSymbol(Decl* sym, bool testconst) {
             // whether their arguments were used or not. We can't tell this until
             // the scope is exiting, which is right here, so peek at the arguments
             // for the function and check now.
-            if (canonical->body()) {
+            if (canonical->body() && !canonical->is_body_skipped()) {
                 CheckFunctionReturnUsage(canonical);
                 if (canonical->scope() && !canonical->is_callback())
                     TestSymbols(canonical->scope(), true);
@@ -3071,6 +3071,10 @@ bool Semantics::CheckFunctionDeclImpl(FunctionDecl* info) {
         report(info->pos(), 10);
         return false;
     }
+    // Liveness isn't known yet. The code generator reports an error if a
+    // skipped body turns out to be live.
+    if (info->is_body_skipped())
+        return true;
 
     // We never warn about unused member functions.
     if (info->as<MemberFunctionDecl>())
@@ -3367,7 +3371,10 @@ void fill_arg_defvalue(CompileContext& cc, ArgDecl* decl) {
         assert(sym->vclass() == sGLOBAL);
         assert(sym->as<VarDecl>());
 
+        // Call sites take this global's address directly, so keep it live
+        // rather than tracking which of them survive.
         def->sym = sym->as<VarDecl>();
+        def->sym->set_is_live();
     } else {
         auto array = cc.NewDefaultArrayData();
         BuildArrayInitializer(decl, array, 0);
@@ -3394,8 +3401,8 @@ SymbolScope* Semantics::current_scope() const {
 
 // Determine the set of live functions.
 void Semantics::DeduceLiveness() {
-    std::vector<FunctionDecl*> work;
-    std::unordered_set<FunctionDecl*> seen;
+    PhaseList<FunctionDecl*> work;
+    PhaseSet<FunctionDecl*> seen;
 
     // The root set is all public functions.
     for (const auto& decl : cc_.publics()) {
@@ -3408,9 +3415,14 @@ void Semantics::DeduceLiveness() {
         work.emplace_back(decl);
     }
 
-    // Traverse referrers to find the transitive set of live functions.
+    // Traverse referrers to find the transitive set of live functions. Any
+    // global a live function touches is live as well.
     while (!work.empty()) {
         FunctionDecl* live = ke::PopBack(&work);
+        if (live->refers_to_globals()) {
+            for (const auto& var : *live->refers_to_globals())
+                var->set_is_live();
+        }
         if (!live->refers_to())
             continue;
 
@@ -3425,8 +3437,8 @@ void Semantics::DeduceLiveness() {
 }
 
 void Semantics::DeduceMaybeUsed() {
-    std::vector<FunctionDecl*> work;
-    std::unordered_set<FunctionDecl*> seen;
+    PhaseList<FunctionDecl*> work;
+    PhaseSet<FunctionDecl*> seen;
 
     while (!maybe_used_.empty()) {
         auto decl = ke::PopBack(&maybe_used_);
@@ -18,6 +18,8 @@
 #ifndef _include_spcomp_smx_assembly_buffer_h_
 #define _include_spcomp_smx_assembly_buffer_h_
 
+#include <vector>
+
 #include "shared/byte-buffer.h"
 #include <smx/smx-v1-opcodes.h>
 #include <sp_vm_types.h>
@@ -40,32 +42,39 @@ class SmxAssemblyBuffer : public ByteBuffer
   {}
 
   void emit(OPCODE op) {
-    write<cell_t>(static_cast<cell_t>(op));
+    if (op == OP_LOAD_I && last_op_ == OP_IDXADDR && can_fuse()) {
+      // idxaddr + load.i is exactly lidx.
+      rewrite_last(OP_LIDX);
+      return;
+    }
+    begin(op);
   }
   void emit(OPCODE op, cell_t param) {
-    write<cell_t>(static_cast<cell_t>(op));
+    if (fuse_push(op, param) || fuse_load_both(op, param))
+      return;
+    begin(op);
     write<cell_t>(param);
   }
   void emit(OPCODE op, cell_t param1, cell_t param2) {
-    write<cell_t>(static_cast<cell_t>(op));
+    begin(op);
     write<cell_t>(param1);
     write<cell_t>(param2);
   }
   void emit(OPCODE op, cell_t param1, cell_t param2, cell_t param3) {
-    write<cell_t>(static_cast<cell_t>(op));
+    begin(op);
     write<cell_t>(param1);
     write<cell_t>(param2);
     write<cell_t>(param3);
   }
   void emit(OPCODE op, cell_t param1, cell_t param2, cell_t param3, cell_t param4) {
-    write<cell_t>(static_cast<cell_t>(op));
+    begin(op);
     write<cell_t>(param1);
     write<cell_t>(param2);
     write<cell_t>(param3);
     write<cell_t>(param4);
   }
   void emit(OPCODE op, cell_t param1, cell_t param2, cell_t param3, cell_t param4, cell_t param5) {
-    write<cell_t>(static_cast<cell_t>(op));
+    begin(op);
     write<cell_t>(param1);
     write<cell_t>(param2);
     write<cell_t>(param3);
@@ -73,11 +82,39 @@ class SmxAssemblyBuffer : public ByteBuffer
     write<cell_t>(param5);
   }
   void emit(OPCODE op, Label* address) {
-    write<cell_t>(static_cast<cell_t>(op));
+    begin(op);
     encodeAbsoluteAddress(address);
   }
+
+  // Emit an instruction whose first operand is the address of a global. The
+  // address of a zero-filled global is relative to the zero-filled region
+  // until relocate_zero_filled() is called, so the operand is recorded. These
+  // instructions are never fused, which keeps the operand where it was
+  // written.
+  void emit_global(OPCODE op, VarDeclBase* sym) {
+    if (!sym->is_zero_filled()) {
+      emit(op, sym->addr());
+      return;
+    }
+    fence();
+    emit(op, sym->addr());
+    zero_filled_relocs_.emplace_back(pc() - sizeof(cell_t));
+    fence();
+  }
+  void emit_global(OPCODE op, VarDeclBase* sym, cell_t param2) {
+    emit(op, sym->addr(), param2);
+    if (sym->is_zero_filled())
+      zero_filled_relocs_.emplace_back(pc() - 2 * sizeof(cell_t));
+  }
+
+  void relocate_zero_filled(cell_t base) {
+    if (oom())
+      return;
+    for (const auto& pos : zero_filled_relocs_)
+      *ptr<cell_t>(pos) += base;
+  }
   void emit(OPCODE op, DataLabel* value) {
-    write<cell_t>(static_cast<cell_t>(op));
+    begin(op);
     write<cell_t>(static_cast<cell_t>(0xb0b0b0b0));
     value->use(pc());
   }
@@ -158,16 +195,26 @@ class SmxAssemblyBuffer : public ByteBuffer
         if (sym->vclass() == sLOCAL || sym->vclass() == sARGUMENT)
           emit(OP_ADDR_PRI, sym->addr());
         else
-          emit(OP_CONST_PRI, sym->addr());
+          emit_global(OP_CONST_PRI, sym);
       } else {
         if (sym->vclass() == sLOCAL || sym->vclass() == sARGUMENT)
           emit(OP_ADDR_ALT, sym->addr());
         else
-          emit(OP_CONST_ALT, sym->addr());
+          emit_global(OP_CONST_ALT, sym);
       }
     }
   }
 
+  // Push the address of a variable, mirroring address().
+  void push_address(VarDeclBase* sym) {
+    if (sym->ident() == iREFARRAY || sym->ident() == iREFERENCE)
+      emit(OP_PUSH_S, sym->addr());
+    else if (sym->vclass() == sLOCAL || sym->vclass() == sARGUMENT)
+      emit(OP_PUSH_ADR, sym->addr());
+    else
+      emit_global(OP_PUSH_C, sym);
+  }
+
   void copyarray(VarDeclBase* sym, cell size) {
     if (sym->ident() == iREFARRAY) {
       assert(sym->vclass() == sLOCAL || sym->vclass() == sARGUMENT); // symbol must be stack relative
@@ -175,13 +222,13 @@ class SmxAssemblyBuffer : public ByteBuffer
     } else if (sym->vclass() == sLOCAL || sym->vclass() == sARGUMENT) {
       emit(OP_ADDR_ALT, sym->addr());
     } else {
-      emit(OP_CONST_ALT, sym->addr());
+      emit_global(OP_CONST_ALT, sym);
     }
     emit(OP_MOVS, size);
   }
 
   void casetbl(cell_t ncases, Label* def) {
-    write<cell_t>(static_cast<cell_t>(OP_CASETBL));
+    begin(OP_CASETBL);
     write<cell_t>(ncases);
     encodeAbsoluteAddress(def);
   }
@@ -191,13 +238,27 @@ class SmxAssemblyBuffer : public ByteBuffer
   }
 
   void sysreq_n(Label* address, uint32_t nparams) {
-    write<cell_t>(static_cast<cell_t>(OP_SYSREQ_N));
+    begin(OP_SYSREQ_N);
     encodeAbsoluteAddress(address);
     write<cell_t>(nparams);
   }
 
   void bind(Label* target) {
     bind_to(target, pc());
+    fence();
+  }
+
+  // Peephole fusion is on by default; turning it off emits every instruction
+  // as written, so fused and unfused code can be compared.
+  void set_fuse(bool fuse) {
+    fuse_ = fuse;
+  }
+
+  // Prevent the next instruction from being fused into the previous one. This
+  // must be used whenever the current pc is observed, for example by a jump
+  // target or a debug table entry.
+  void fence() {
+    last_op_ = OP_NONE;
   }
 
   void bind_to(Label* target, cell_t value) {
@@ -244,7 +305,107 @@ class SmxAssemblyBuffer : public ByteBuffer
     return position();
   }
 
+  uint32_t num_instructions() const {
+    return num_instructions_;
+  }
+  uint32_t num_fused() const {
+    return num_fused_;
+  }
+
  private:
+  void begin(OPCODE op) {
+    last_op_pos_ = pc();
+    last_op_ = op;
+    num_instructions_++;
+    write<cell_t>(static_cast<cell_t>(op));
+  }
+
+  bool can_fuse() const {
+    return fuse_ && last_op_ != OP_NONE && !oom();
+  }
+
+  void rewrite_last(OPCODE op) {
+    *ptr<cell_t>(last_op_pos_) = static_cast<cell_t>(op);
+    last_op_ = op;
+    num_fused_++;
+  }
+
+  // Runs of push.c, push, push.s and push.adr are folded into push2..push5.
+  // The fused forms are laid out as one opcode followed by each operand, so
+  // the previous instruction can be extended in place.
+  bool fuse_push(OPCODE op, cell_t param) {
+    OPCODE first;
+    switch (op) {
+      case OP_PUSH_C:
+        first = OP_PUSH2_C;
+        break;
+      case OP_PUSH:
+        first = OP_PUSH2;
+        break;
+      case OP_PUSH_S:
+        first = OP_PUSH2_S;
+        break;
+      case OP_PUSH_ADR:
+        first = OP_PUSH2_ADR;
+        break;
+      default:
+        return false;
+    }
+    if (!can_fuse())
+      return false;
+
+    OPCODE fused;
+    if (last_op_ == op)
+      fused = first;
+    else if (last_op_ >= first && last_op_ <= first + 8 && (last_op_ - first) % 4 == 0)
+      fused = static_cast<OPCODE>(last_op_ + 4);
+    else
+      return false;
+
+    rewrite_last(fused);
+    write<cell_t>(param);
+    return true;
+  }
+
+  // load.s.pri and load.s.alt (or load.pri and load.alt) are independent, so
+  // back-to-back loads into each register can be combined in either order.
+  bool fuse_load_both(OPCODE op, cell_t param) {
+    OPCODE partner, fused;
+    switch (op) {
+      case OP_LOAD_S_PRI:
+        partner = OP_LOAD_S_ALT;
+        fused = OP_LOAD_S_BOTH;
+        break;
+      case OP_LOAD_S_ALT:
+        partner = OP_LOAD_S_PRI;
+        fused = OP_LOAD_S_BOTH;
+        break;
+      case OP_LOAD_PRI:
+        partner = OP_LOAD_ALT;
+        fused = OP_LOAD_BOTH;
+        break;
+      case OP_LOAD_ALT:
+        partner = OP_LOAD_PRI;
+        fused = OP_LOAD_BOTH;
+        break;
+      default:
+        return false;
+    }
+    if (last_op_ != partner || !can_fuse())
+      return false;
+
+    // Operands are ordered (pri, alt).
+    cell_t prev = *ptr<cell_t>(last_op_pos_ + sizeof(cell_t));
+    bool op_is_pri = (op == OP_LOAD_S_PRI || op == OP_LOAD_PRI);
+    rewrite_last(fused);
+    *ptr<cell_t>(last_op_pos_ + sizeof(cell_t)) = op_is_pri ? param : prev;
+    write<cell_t>(op_is_pri ? prev : param);
+
+    // Don't chain further fusion off a two-register load.
+    fence();
+    return true;
+  }
+
   void encodeAbsoluteAddress(Label* address) {
     if (address->bound()) {
       write<cell_t>(address->offset());
@@ -252,6 +413,14 @@ class SmxAssemblyBuffer : public ByteBuffer
       write<cell_t>(address->addPending(pc() + sizeof(cell_t)));
     }
   }
+
+ private:
+  OPCODE last_op_ = OP_NONE;
+  uint32_t last_op_pos_ = 0;
+  uint32_t num_instructions_ = 0;
+  uint32_t num_fused_ = 0;
+  bool fuse_ = true;
+  std::vector<uint32_t> zero_filled_relocs_;
 };
 
 }
@@ -23,34 +23,101 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#if !defined(S_ISDIR)
+# define S_ISDIR(m) (((m) & S_IFMT) == S_IFDIR)
+#endif
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
 #ifdef _WIN32
 # include <io.h>
 #else
 # include <unistd.h>
 #endif
 
+#include "lexer-scan.h"
+
 namespace sp {
 
+// When enabled, file contents are kept for the lifetime of the process and
+// shared by every compilation that opens the same path.
+static bool sUseSharedCache = false;
+static std::mutex sCacheLock;
+
+struct CachedContents {
+    FileStamp stamp;
+    std::shared_ptr<const std::string> data;
+};
+static std::unordered_map<std::string, CachedContents> sCache;
+
+// Coarsest mtime resolution we expect to see (FAT stores two seconds).
+static const int64_t kTimestampGranularityNs = 2000000000;
+
+bool FileStamp::Get(const std::string& path, FileStamp* stamp) {
+    struct stat s;
+    if (stat(path.c_str(), &s) != 0)
+        return false;
+    if (S_ISDIR(s.st_mode))
+        return false;
+
+    stamp->size = s.st_size;
+#if defined(__APPLE__)
+    stamp->mtime_ns = int64_t(s.st_mtimespec.tv_sec) * 1000000000 + s.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    stamp->mtime_ns = int64_t(s.st_mtime) * 1000000000;
+#else
+    stamp->mtime_ns = int64_t(s.st_mtim.tv_sec) * 1000000000 + s.st_mtim.tv_nsec;
+#endif
+
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    stamp->taken_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    return true;
+}
+
+bool FileStamp::Proves(const FileStamp& now) const {
+    if (size != now.size || mtime_ns != now.mtime_ns)
+        return false;
+    return taken_ns - mtime_ns > kTimestampGranularityNs;
+}
+
+void SourceFile::EnableSharedCache() {
+    sUseSharedCache = true;
+}
+
 SourceFile::SourceFile()
-  : pos_(0)
+  : data_(std::make_shared<std::string>()),
+    pos_(0)
 {
 }
 
 SourceFile::SourceFile(const std::string& name, tr::string&& data)
   : name_(name),
-    data_(std::move(data)),
+    data_(std::make_shared<std::string>(data.data(), data.size())),
     is_builtin_(true)
 {}
 
 bool
 SourceFile::Open(const std::string& file_name)
 {
-    struct stat s;
-    if (stat(file_name.c_str(), &s) != 0)
-        return false;
-    if ((s.st_mode & S_IFDIR) == S_IFDIR)
+    // Stamp the file before reading it, so a write that lands during the read
+    // makes the stamp look stale rather than the contents look current.
+    FileStamp stamp;
+    if (!FileStamp::Get(file_name, &stamp))
         return false;
 
+    if (sUseSharedCache) {
+        std::lock_guard<std::mutex> lock(sCacheLock);
+        auto iter = sCache.find(file_name);
+        if (iter != sCache.end() && iter->second.stamp.Proves(stamp)) {
+            data_ = iter->second.data;
+            name_ = file_name;
+            stamp_ = stamp;
+            return true;
+        }
+    }
+
     std::unique_ptr<FILE, decltype(&::fclose)> fp(fopen(file_name.c_str(), "rb"), &::fclose);
     if (!fp)
         return false;
@@ -63,12 +130,18 @@ SourceFile::Open(const std::string& file_name)
     if (fseek(fp.get(), 0, SEEK_SET) != 0)
         return false;
 
-    data_.resize(len, '\0');
-    data_.shrink_to_fit();
-    if (fread(&data_[0], data_.size(), 1, fp.get()) != 1)
+    std::string data(len, '\0');
+    if (len && fread(&data[0], data.size(), 1, fp.get()) != 1)
         return false;
 
+    data_ = std::make_shared<std::string>(std::move(data));
     name_ = file_name;
+    stamp_ = stamp;
+
+    if (sUseSharedCache) {
+        std::lock_guard<std::mutex> lock(sCacheLock);
+        sCache[file_name] = CachedContents{stamp, data_};
+    }
     return true;
 }
 
@@ -78,29 +151,33 @@ int64_t SourceFile::Pos() {
 
 void SourceFile::Reset(int64_t pos) {
     assert(pos >= 0);
-    assert((size_t)pos <= data_.size());
+    assert((size_t)pos <= data_->size());
     pos_ = (size_t)pos;
 }
 
 int SourceFile::Eof() {
-    return pos_ == data_.size();
+    return pos_ == data_->size();
 }
 
 void SourceFile::ComputeLineExtents() {
     if (!line_extents_.empty())
         return;
 
+    const unsigned char* start = data();
+    const unsigned char* end = start + data_->size();
+
     tr::vector<uint32_t> extents;
     extents.emplace_back(0);
-    for (uint32_t i = 0; i < data_.size(); i++) {
-        if (data_[i] != '\r' && data_[i] != '\n')
-            continue;
-        if (data_[i] == '\r') {
+    for (const unsigned char* pos = start; pos < end; pos++) {
+        pos = FindAnyOf<'\r', '\n'>(pos, end);
+        if (pos == end)
+            break;
+        if (*pos == '\r') {
             // Detect \r\n.
-            if (i + 1 < data_.size() && data_[i + 1] == '\n')
-                i++;
+            if (pos + 1 < end && pos[1] == '\n')
+                pos++;
         }
-        extents.emplace_back(i + 1);
+        extents.emplace_back((uint32_t)(pos + 1 - start));
     }
 
 
@@ -110,12 +187,12 @@ void SourceFile::ComputeLineExtents() {
 }
 
 bool SourceFile::OffsetToLineAndCol(uint32_t offset, uint32_t* line, uint32_t* col) {
-    if (offset > data_.size())
+    if (offset > data_->size())
         return false;
 
     ComputeLineExtents();
 
-    if (offset == data_.size()) {
+    if (offset == data_->size()) {
         *line = line_extents_.size();
         if (col)
             *col = 0;
@@ -135,7 +212,7 @@ bool SourceFile::OffsetToLineAndCol(uint32_t offset, uint32_t* line, uint32_t* c
         // The range should be (start, end].
         uint32_t line_end = (index < line_extents_.size() - 1)
                             ? line_extents_[index + 1]
-                            : data_.size();
+                            : data_->size();
         if (offset >= line_end) {
             lower = index + 1;
             continue;
@@ -163,7 +240,7 @@ bool SourceFile::OffsetOfLine(uint32_t line, uint32_t* offset) {
         return false;
 
     if (line_index == line_extents_.size())
-        *offset = data_.size();
+        *offset = data_->size();
     else
         *offset = line_extents_[line_index];
     return true;
@@ -178,9 +255,9 @@ tr::string SourceFile::GetLine(uint32_t line) {
 
     uint32_t end;
     if (!OffsetOfLine(line + 1, &end))
-        end = data_.size();
+        end = data_->size();
 
-    return data_.substr(offset, end - offset);
+    return tr::string(data_->data() + offset, end - offset);
 }
 
 } // namespace sp
@@ -30,6 +30,24 @@
 
 namespace sp {
 
+// A file's size and modification time, taken with the best precision the
+// platform offers.
+struct FileStamp {
+    int64_t size = 0;
+    int64_t mtime_ns = 0;
+    // Wall-clock time at which the stamp was taken.
+    int64_t taken_ns = 0;
+
+    static bool Get(const std::string& path, FileStamp* stamp);
+
+    // Whether |now|, a later stamp of the same file, proves its contents are
+    // still the ones seen when this stamp was taken. Size and mtime must match,
+    // and the mtime must have been older than the filesystem's timestamp
+    // granularity when this stamp was taken; otherwise a second write in the
+    // same tick would go unnoticed.
+    bool Proves(const FileStamp& now) const;
+};
+
 class SourceFile : public std::enable_shared_from_this<SourceFile>
 {
     friend class SourceManager;
@@ -47,7 +65,8 @@ class SourceFile : public std::enable_shared_from_this<SourceFile>
 
     const char* name() const { return name_.c_str(); }
     const std::string& path() const { return name_; }
-    size_t size() const { return data_.size(); }
+    size_t size() const { return data_->size(); }
+    const FileStamp& stamp() const { return stamp_; }
     uint32_t sources_index() const { return sources_index_.get(); }
 
     bool is_main_file() const { return is_main_file_; }
@@ -60,11 +79,15 @@ class SourceFile : public std::enable_shared_from_this<SourceFile>
     void operator =(const SourceFile&) = delete;
     void operator =(SourceFile&&) = delete;
     const unsigned char* data() const {
-        return reinterpret_cast<const unsigned char*>(data_.data());
+        return reinterpret_cast<const unsigned char*>(data_->data());
     }
 
     std::shared_ptr<SourceFile> to_shared() { return shared_from_this(); }
 
+    // Share file contents across every compilation in this process. Used when
+    // compiling many files at once.
+    static void EnableSharedCache();
+
     bool OffsetToLineAndCol(uint32_t offset, uint32_t* line, uint32_t* col = nullptr);
     bool OffsetOfLine(uint32_t line, uint32_t* offset);
     tr::string GetLine(uint32_t line);
@@ -77,7 +100,8 @@ class SourceFile : public std::enable_shared_from_this<SourceFile>
 
   private:
     std::string name_;
-    tr::string data_;
+    std::shared_ptr<const std::string> data_;
+    FileStamp stamp_;
     size_t pos_;
     bool is_main_file_ = false;
     bool included_ = false;
@@ -17,6 +17,13 @@
 // SourcePawn. If not, see http://www.gnu.org/licenses/.
 #include "source-manager.h"
 
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if !defined(S_ISDIR)
+# define S_ISDIR(m) (((m) & S_IFMT) == S_IFDIR)
+#endif
+
 #include <filesystem>
 #include <limits>
 
@@ -35,17 +42,38 @@ SourceManager::SourceManager(CompileContext& cc)
 }
 
 std::shared_ptr<SourceFile> SourceManager::Open(const token_pos_t& from, const std::string& path) {
+    // The lexer probes several candidate paths for each #include, most of
+    // which do not exist. Reject those with a single stat, and find files
+    // we've already opened by device and inode rather than comparing against
+    // every open file. Symlinks and hard links to an open file resolve to it.
+    struct stat s;
+    if (stat(path.c_str(), &s) != 0 || S_ISDIR(s.st_mode)) {
+        missing_files_.emplace_back(path);
+        return nullptr;
+    }
+
+#if defined(_WIN32)
+    // stat() does not report file indices on Windows.
     for (const auto& other : opened_files_) {
         std::error_code ec;
         if (std::filesystem::equivalent(path, other->path(), ec))
             return other;
     }
+#else
+    FileId id{uint64_t(s.st_dev), uint64_t(s.st_ino)};
+    auto iter = files_by_id_.find(id);
+    if (iter != files_by_id_.end())
+        return iter->second;
+#endif
 
     auto file = std::make_shared<SourceFile>();
     if (!file->Open(path))
         return nullptr;
     if (!Open(from, file))
         return nullptr;
+#if !defined(_WIN32)
+    files_by_id_.emplace(id, file);
+#endif
     return file;
 }
 
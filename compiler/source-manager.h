@@ -177,6 +177,12 @@ class SourceManager final
       return opened_files_;
     }
 
+    // Paths that were probed for an #include but did not exist. If one of
+    // these appears later, it may shadow a file that was opened instead.
+    const tr::vector<std::string>& missing_files() const {
+      return missing_files_;
+    }
+
     // Find the index of the owning LocationRange. 0 is an invalid range.
     size_t FindLocRange(const SourceLocation& loc) {
         if (loc_ranges_[last_lr_lookup_].owns(loc))
@@ -193,6 +199,22 @@ class SourceManager final
   private:
     CompileContext& cc_;
     tr::vector<std::shared_ptr<SourceFile>> opened_files_;
+    tr::vector<std::string> missing_files_;
+
+    struct FileId {
+        uint64_t device;
+        uint64_t inode;
+        bool operator ==(const FileId& other) const {
+            return device == other.device && inode == other.inode;
+        }
+    };
+    struct FileIdHash {
+        size_t operator ()(const FileId& id) const {
+            return std::hash<uint64_t>()(id.inode) ^ (std::hash<uint64_t>()(id.device) << 1);
+        }
+    };
+    tr::unordered_map<FileId, std::shared_ptr<SourceFile>, FileIdHash> files_by_id_;
+
     tr::vector<LocationRange> loc_ranges_;
 
     // Source ids start from 1. The source file id is 1 + len(source) + 1. This
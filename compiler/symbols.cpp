@@ -32,12 +32,33 @@
 
 namespace sp {
 
+static void markglobalusage(VarDeclBase* var, int usage) {
+    if (var->vclass() != sGLOBAL && var->vclass() != sSTATIC)
+        return;
+
+    // Globals referenced from inside a function are only live if that function
+    // is. A read anywhere else (sizeof in an array dimension, for example)
+    // keeps the global alive. Writes outside a function are only ever the
+    // global's own initializer, which doesn't count.
+    auto& cc = CompileContext::get();
+    FunctionDecl* parent_func = cc.sema() ? cc.sema()->func() : nullptr;
+    if (!parent_func) {
+        if (usage & uREAD)
+            var->set_is_live();
+        return;
+    }
+
+    assert(parent_func->canonical() == parent_func);
+    parent_func->AddGlobalReference(var);
+}
+
 void markusage(Decl* decl, int usage) {
     if (auto var = decl->as<VarDeclBase>()) {
         if (usage & uREAD)
             var->set_is_read();
         if (usage & uWRITTEN)
             var->set_is_written();
+        markglobalusage(var, usage);
         return;
     }
 
@@ -81,6 +81,11 @@ struct SmxConsts {
 
     // This feature indicates that INVALID_FUNCTION is null (0) instead of -1.
     static const uint32_t kCodeFeatureNullFunctions = (1 << 3);
+
+    // This feature indicates that the ".data" blob may be shorter than
+    // |datasize|. Only the initialized prefix is stored, and the remainder is
+    // zero-filled at load time.
+    static const uint32_t kCodeFeatureZeroFilledData = (1 << 4);
 };
 
 // These structures are byte-packed.
@@ -24,7 +24,7 @@
 
 /** SourcePawn Engine API Versions */
 #define SOURCEPAWN_ENGINE2_API_VERSION 0x10
-#define SOURCEPAWN_API_VERSION 0x0213
+#define SOURCEPAWN_API_VERSION 0x0216
 
 namespace SourceMod {
 struct IdentityToken_t;
@@ -598,6 +598,29 @@ class IPluginRuntime
      * had relative indirection vectors.
      */
     virtual bool UsesDirectArrays() = 0;
+
+    /**
+     * @brief Arms or disarms a breakpoint on a source line. When debug breaks
+     * are enabled, each statement has a break site that is compiled as a
+     * no-op, and only calls the debug break handler while armed.
+     *
+     * @param file      Name of the file containing the line.
+     * @param line      Line number. The breakpoint is placed on the next
+     *                  breakable line if this line has no code.
+     * @param enabled   True to arm the breakpoint, false to disarm it.
+     * @return          Error code, SP_ERROR_NONE on success.
+     */
+    virtual int SetBreakpoint(const char* file, uint32_t line, bool enabled) = 0;
+
+    /**
+     * @brief Arms or disarms every break site in the plugin, so that the
+     * debug break handler is called for each statement. Until this is
+     * called, single-stepping is on whenever a debug break handler is
+     * installed.
+     *
+     * @param enabled   True to call the handler on every statement.
+     */
+    virtual void SetSingleStep(bool enabled) = 0;
 };
 
 /**
@@ -1230,6 +1253,27 @@ class IPluginContext
      * the function is invalid or null.
      */
     virtual IPluginFunction* GetFunctionByIdOrError(funcid_t func) = 0;
+
+    /**
+     * @brief Sets the execution budget of this context. Every function call
+     * and loop iteration uses one unit, and once the budget runs out,
+     * execution stops with SP_ERROR_OUT_OF_FUEL. Every call into the plugin
+     * from the host starts with the full budget. Calls made by natives
+     * while the plugin is running share what is left of it.
+     *
+     * This has no effect unless fuel metering was enabled on the
+     * environment.
+     *
+     * @param units     Number of units, or 0 to remove the limit.
+     */
+    virtual void SetFuelBudget(uint32_t units) = 0;
+
+    /**
+     * @brief Returns the remaining execution budget of the current
+     * invocation, or of the last one if none is running. Returns UINT32_MAX
+     * if there is no limit.
+     */
+    virtual uint32_t GetFuelRemaining() = 0;
 };
 
 class AutoEnterHeapScope
@@ -1777,6 +1821,17 @@ class ISourcePawnEnvironment
     // @brief See JIT_DEBUG_* flags.
     // Must be set before any plugin code is executed.
     virtual void SetDebugMetadataFlags(int flags) = 0;
+
+    // @brief Makes JIT code poll a timeout flag at loop back-edges, instead
+    // of the watchdog patching every back-edge when it fires. This must be
+    // called before any plugins are loaded.
+    virtual bool EnablePolledInterrupts() = 0;
+
+    // @brief Makes JIT and interpreted code count function calls and loop
+    // iterations against each context's fuel budget. See
+    // IPluginContext::SetFuelBudget. This must be called before any plugins
+    // are loaded.
+    virtual bool EnableFuelMetering() = 0;
 };
 
 // @brief This class is the entry-point to using SourcePawn from a DLL.
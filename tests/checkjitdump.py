@@ -0,0 +1,173 @@
+# vim: set ts=2 sw=2 tw=99 et:
+import argparse
+import os
+import struct
+import subprocess
+import sys
+
+import testutil
+from runtests import TestPlan
+
+# Runs a plugin under each JIT-enabled spshell with perf metadata enabled, and
+# checks that the jitdump and perf map files it leaves behind are well-formed
+# enough for "perf inject --jit". To profile for real:
+#
+#   perf record -k 1 -g spshell --jitdump plugin.smx
+#   perf inject --jit -i perf.data -o perf.jit.data
+#   perf report -i perf.jit.data
+#
+JITHEADER_MAGIC = 0x4A695444
+JIT_CODE_LOAD = 0
+JIT_CODE_MOVE = 1
+JIT_CODE_DEBUG_INFO = 2
+JIT_CODE_CLOSE = 3
+
+kHeader = struct.Struct('<IIIIIIQQ')
+kPrefix = struct.Struct('<IIQ')
+kCodeLoad = struct.Struct('<IIQQQQ')
+kDebugInfo = struct.Struct('<QQ')
+kDebugEntry = struct.Struct('<Qii')
+
+def read_cstring(data, pos):
+  end = data.index(b'\0', pos)
+  return data[pos:end].decode('utf-8'), end + 1
+
+def check_jitdump(path):
+  with open(path, 'rb') as fp:
+    data = fp.read()
+
+  magic, version, header_size, _, _, _, _, _ = kHeader.unpack_from(data, 0)
+  if magic != JITHEADER_MAGIC:
+    raise Exception('bad jitdump magic: {0:x}'.format(magic))
+  if version != 1:
+    raise Exception('unexpected jitdump version: {0}'.format(version))
+
+  pos = header_size
+  loads = {}
+  code_indices = set()
+  pending_debug = None
+  closed = False
+  while pos < len(data):
+    if closed:
+      raise Exception('record found after JIT_CODE_CLOSE')
+
+    id, total_size, _ = kPrefix.unpack_from(data, pos)
+    if total_size < kPrefix.size or pos + total_size > len(data):
+      raise Exception('truncated record at offset {0}'.format(pos))
+    body = pos + kPrefix.size
+
+    if id == JIT_CODE_DEBUG_INFO:
+      code_addr, nr_entry = kDebugInfo.unpack_from(data, body)
+      entry_pos = body + kDebugInfo.size
+      entries = []
+      for _ in range(nr_entry):
+        addr, lineno, _ = kDebugEntry.unpack_from(data, entry_pos)
+        name, entry_pos = read_cstring(data, entry_pos + kDebugEntry.size)
+        if lineno < 1:
+          raise Exception('debug entry with line {0} in {1}'.format(lineno, name))
+        entries.append((addr, lineno, name))
+      if entry_pos != pos + total_size:
+        raise Exception('debug record size mismatch at offset {0}'.format(pos))
+      pending_debug = (code_addr, entries)
+    elif id == JIT_CODE_LOAD:
+      _, _, vma, code_addr, code_size, code_index = kCodeLoad.unpack_from(data, body)
+      name, _ = read_cstring(data, body + kCodeLoad.size)
+      if code_index in code_indices:
+        raise Exception('duplicate code index {0} for {1}'.format(code_index, name))
+      code_indices.add(code_index)
+      if pending_debug:
+        debug_addr, entries = pending_debug
+        if debug_addr != code_addr:
+          raise Exception('debug info for {0:x} precedes load of {1:x}'.format(debug_addr, code_addr))
+        for addr, _, entry_name in entries:
+          if addr < code_addr or addr > code_addr + code_size:
+            raise Exception('debug entry {0} lies outside {1}'.format(entry_name, name))
+        pending_debug = None
+      loads[name] = code_addr
+    elif id == JIT_CODE_CLOSE:
+      closed = True
+    elif id != JIT_CODE_MOVE:
+      raise Exception('unknown record type {0}'.format(id))
+
+    pos += total_size
+
+  if pending_debug:
+    raise Exception('debug info without a code load')
+  if not closed:
+    raise Exception('missing JIT_CODE_CLOSE record')
+  if '<jit invoke stub>' not in loads:
+    raise Exception('invoke stub was not recorded')
+  return loads
+
+def check_perf_map(path, loads):
+  symbols = set()
+  with open(path, 'r') as fp:
+    for line in fp:
+      addr, size, name = line.rstrip('\n').split(' ', 2)
+      int(addr, 16)
+      int(size, 16)
+      symbols.add(name)
+  missing = set(loads.keys()) - symbols
+  if missing:
+    raise Exception('symbols missing from perf map: {0}'.format(', '.join(sorted(missing))))
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('objdir', type=str, help='Build folder to check.')
+  parser.add_argument('--arch', type=str, default=None,
+                      help="Force a specific arch on dual-arch builds.")
+  parser.add_argument('--plugin', type=str, default=None,
+                      help='Script to run (defaults to bench/recursion.sp).')
+  args = parser.parse_args()
+
+  tests_path = os.path.dirname(os.path.abspath(__file__))
+  core_include_path = os.path.join(os.path.dirname(tests_path), 'include')
+  script = args.plugin or os.path.join(tests_path, 'bench', 'recursion.sp')
+
+  plan = TestPlan(argparse.Namespace(objdir = args.objdir, test = tests_path, arch = args.arch,
+                                     coverage = None, spcomp2 = False, spcomp_args = None))
+  plan.find_spcomp()
+  plan.find_shells()
+  if not len(plan.modes):
+    raise Exception('No compiler binaries were found in {0}'.format(args.objdir))
+  shells = [shell for shell in plan.shells if '--disable-jit' not in shell['args']]
+  if not len(shells):
+    raise Exception('No JIT-enabled spshell binaries were found in {0}'.format(args.objdir))
+  spcomp = plan.modes[0]['spcomp']
+
+  failed = False
+  with testutil.TempFolder() as temp_folder:
+    smx_path = os.path.join(temp_folder, 'jitdump.smx')
+    argv = [spcomp['path'], '-i', core_include_path, '-i', tests_path, '-o', smx_path, script]
+    rc, stdout, stderr = testutil.exec_argv(argv)
+    if rc != 0:
+      sys.stderr.write('Failed to compile {0}:\n{1}{2}'.format(script, stdout, stderr))
+      return 1
+
+    for shell in shells:
+      argv = [shell['path'], '--jitdump', '--bench', '--bench-iterations', '10',
+              '--bench-samples', '1', smx_path]
+      proc = subprocess.Popen(argv, stdout = subprocess.PIPE, stderr = subprocess.PIPE)
+      stdout, stderr = proc.communicate()
+
+      dump_path = '/tmp/jit-{0}.dump'.format(proc.pid)
+      map_path = '/tmp/perf-{0}.map'.format(proc.pid)
+      try:
+        if proc.returncode != 0:
+          raise Exception('spshell exited with {0}: {1}'.format(proc.returncode,
+                                                               stderr.decode('utf-8')))
+        loads = check_jitdump(dump_path)
+        check_perf_map(map_path, loads)
+        print('{0}: ok ({1} code loads)'.format(shell['name'], len(loads)))
+      except Exception as e:
+        print('{0}: FAILED: {1}'.format(shell['name'], e))
+        failed = True
+      finally:
+        for path in [dump_path, map_path]:
+          if os.path.exists(path):
+            os.unlink(path)
+
+  return 1 if failed else 0
+
+if __name__ == '__main__':
+  sys.exit(main())
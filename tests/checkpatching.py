@@ -0,0 +1,131 @@
+# vim: set ts=2 sw=2 tw=99 et:
+import argparse
+import json
+import os
+import sys
+
+import testutil
+from runtests import TestPlan
+
+# Runs plugins under each JIT-enabled spshell through every path that patches
+# code after it was emitted, and checks with --check-wx that no memory was
+# mapped writable and executable along the way:
+#  - call thunks, patched when a function is first called;
+#  - debug break sites, armed and disarmed by --bench-jit with
+#    --validate-debug-sections;
+#  - loop edges, swapped to the timeout path and back by --bench-jit, and for
+#    real by the watchdog when a plugin never returns.
+
+kPatchPlugin = '''
+#include <shell>
+
+stock int Fib(int n) {
+  if (n < 2)
+    return n;
+  return Fib(n - 1) + Fib(n - 2);
+}
+
+stock int SumTo(int n) {
+  int total = 0;
+  for (int i = 0; i < n; i++)
+    total += i;
+  return total;
+}
+
+public int bench() {
+  return Fib(10) + SumTo(100);
+}
+
+public main() {
+  printnum(bench());
+}
+'''
+
+kTimeoutPlugin = '''
+#include <shell>
+
+public main() {
+  int n = 0;
+  for (;;)
+    n++;
+}
+'''
+
+kTimeoutError = 'Error executing main: Script execution timed out'
+
+def compile_plugin(spcomp, include_paths, folder, name, text):
+  sp_path = os.path.join(folder, name + '.sp')
+  smx_path = os.path.join(folder, name + '.smx')
+  with open(sp_path, 'w') as fp:
+    fp.write(text)
+
+  argv = [spcomp['path']]
+  for path in include_paths:
+    argv += ['-i', path]
+  argv += ['-o', smx_path, sp_path]
+  rc, stdout, stderr = testutil.exec_argv(argv)
+  if rc != 0:
+    raise Exception('Failed to compile {0}:\n{1}{2}'.format(name, stdout, stderr))
+  return smx_path
+
+def check_patching(shell, smx_path):
+  argv = [shell['path'], '--check-wx', '--validate-debug-sections', '--bench-jit',
+          '--bench-iterations', '100', '--bench-samples', '2', smx_path]
+  rc, stdout, stderr = testutil.exec_argv(argv)
+  if rc != 0:
+    raise Exception('spshell exited with {0}: {1}'.format(rc, stderr))
+
+  result = json.loads(stdout)
+  for key in ['compile_mean_ns', 'timeout_patch_mean_ns', 'debug_break_patch_mean_ns']:
+    if key not in result:
+      raise Exception('missing "{0}" in {1}'.format(key, stdout.strip()))
+  if result['functions'] != 2:
+    raise Exception('expected 2 public functions, got {0}'.format(result['functions']))
+
+def check_timeout(shell, smx_path):
+  argv = [shell['path'], '--check-wx', '--watchdog-timeout', '200', smx_path]
+  rc, stdout, stderr = testutil.exec_argv(argv)
+  if rc != 1 or kTimeoutError not in stderr:
+    raise Exception('expected "{0}", got exit code {1}: {2}'.format(kTimeoutError, rc, stderr))
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('objdir', type=str, help='Build folder to check.')
+  parser.add_argument('--arch', type=str, default=None,
+                      help="Force a specific arch on dual-arch builds.")
+  args = parser.parse_args()
+
+  tests_path = os.path.dirname(os.path.abspath(__file__))
+  core_include_path = os.path.join(os.path.dirname(tests_path), 'include')
+
+  plan = TestPlan(argparse.Namespace(objdir = args.objdir, test = tests_path, arch = args.arch,
+                                     coverage = None, spcomp2 = False, spcomp_args = None))
+  plan.find_spcomp()
+  plan.find_shells()
+  if not len(plan.modes):
+    raise Exception('No compiler binaries were found in {0}'.format(args.objdir))
+  shells = [shell for shell in plan.shells if '--disable-jit' not in shell['args']]
+  if not len(shells):
+    raise Exception('No JIT-enabled spshell binaries were found in {0}'.format(args.objdir))
+  spcomp = plan.modes[0]['spcomp']
+
+  failed = False
+  with testutil.TempFolder() as temp_folder:
+    include_paths = [core_include_path, tests_path]
+    patch_smx = compile_plugin(spcomp, include_paths, temp_folder, 'patching', kPatchPlugin)
+    timeout_smx = compile_plugin(spcomp, include_paths, temp_folder, 'timeout', kTimeoutPlugin)
+
+    for shell in shells:
+      for name, check, smx_path in [('patching', check_patching, patch_smx),
+                                    ('timeout', check_timeout, timeout_smx)]:
+        try:
+          check(shell, smx_path)
+          print('{0}: {1}: ok'.format(shell['name'], name))
+        except Exception as e:
+          print('{0}: {1}: FAILED: {2}'.format(shell['name'], name, e))
+          failed = True
+
+  return 1 if failed else 0
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,134 @@
+# vim: set ts=2 sw=2 tw=99 et:
+import argparse
+import os
+import subprocess
+import sys
+
+import testutil
+from runtests import TestPlan
+
+# Drives "spcomp --server" through a series of edits and checks that it only
+# reuses a previous result when nothing the plugin includes has changed,
+# including edits that keep the file size and mtime of the original, and new
+# files that shadow an include it found further down the include path.
+
+kPlugin = '''
+#include <shell>
+#include "dep.inc"
+#include <extra>
+
+public main() {
+  printnum(kValue + kExtra);
+}
+'''
+
+def write_dep(path, value, name = 'kValue'):
+  with open(path, 'w') as fp:
+    fp.write('#define {0} {1}\n'.format(name, value))
+
+class Server(object):
+  def __init__(self, argv):
+    self.proc = subprocess.Popen(argv, stdin = subprocess.PIPE, stdout = subprocess.PIPE)
+
+  def compile(self, path):
+    self.proc.stdin.write('compile {0}\n'.format(path).encode('utf-8'))
+    self.proc.stdin.flush()
+    header = self.proc.stdout.readline().decode('utf-8').split()
+    if len(header) != 5 or header[0] != 'result':
+      raise Exception('bad response: {0}'.format(' '.join(header)))
+    diagnostics = self.proc.stdout.read(int(header[3]))
+    smx = self.proc.stdout.read(int(header[4]))
+    return header[1], diagnostics, smx
+
+  def close(self):
+    self.proc.stdin.write(b'quit\n')
+    self.proc.stdin.flush()
+    self.proc.wait()
+
+def expect(step, status, wanted):
+  if status != wanted:
+    raise Exception('{0}: expected "{1}", got "{2}"'.format(step, wanted, status))
+  print('{0}: {1}'.format(step, status))
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('objdir', type=str, help='Build folder to check.')
+  parser.add_argument('--arch', type=str, default=None,
+                      help="Force a specific arch on dual-arch builds.")
+  args = parser.parse_args()
+
+  tests_path = os.path.dirname(os.path.abspath(__file__))
+  core_include_path = os.path.join(os.path.dirname(tests_path), 'include')
+
+  plan = TestPlan(argparse.Namespace(objdir = args.objdir, test = tests_path, arch = args.arch,
+                                     coverage = None, spcomp2 = False, spcomp_args = None))
+  plan.find_spcomp()
+  if not len(plan.modes):
+    raise Exception('No compiler binaries were found in {0}'.format(args.objdir))
+  spcomp = plan.modes[0]['spcomp']
+
+  # Reports printed to stdout would corrupt the server's replies.
+  for option in ['--show-stats', '--time-phases', '--show-includes']:
+    rc, _, _ = testutil.exec_argv([spcomp['path'], '--server', option])
+    if rc == 0:
+      raise Exception('--server accepted {0}'.format(option))
+    print('rejected {0}'.format(option))
+
+  with testutil.TempFolder() as temp_folder:
+    plugin_path = os.path.join(temp_folder, 'plugin.sp')
+    dep_path = os.path.join(temp_folder, 'dep.inc')
+    first_path = os.path.join(temp_folder, 'first')
+    second_path = os.path.join(temp_folder, 'second')
+    os.mkdir(first_path)
+    os.mkdir(second_path)
+    with open(plugin_path, 'w') as fp:
+      fp.write(kPlugin)
+    write_dep(dep_path, 10)
+    write_dep(os.path.join(second_path, 'extra.inc'), 1, 'kExtra')
+
+    server = Server([spcomp['path'], '--server', '-i', core_include_path, '-i', tests_path,
+                     '-i', first_path, '-i', second_path])
+    try:
+      status, _, first = server.compile(plugin_path)
+      expect('initial compile', status, 'ok')
+
+      status, _, smx = server.compile(plugin_path)
+      expect('unchanged include', status, 'unchanged')
+      if smx != first:
+        raise Exception('reused result does not match the original')
+
+      # Same size, and the mtime is put back: only the contents differ.
+      st = os.stat(dep_path)
+      write_dep(dep_path, 20)
+      os.utime(dep_path, ns = (st.st_atime_ns, st.st_mtime_ns))
+      status, _, smx = server.compile(plugin_path)
+      expect('same-size edit, same mtime', status, 'ok')
+      if smx == first:
+        raise Exception('edited include produced the same binary')
+      edited = smx
+
+      # Touched but not edited.
+      os.utime(dep_path, None)
+      status, _, smx = server.compile(plugin_path)
+      expect('touched include', status, 'unchanged')
+      if smx != edited:
+        raise Exception('reused result does not match the edited compile')
+
+      write_dep(dep_path, 300)
+      status, _, smx = server.compile(plugin_path)
+      expect('resized include', status, 'ok')
+      resized = smx
+
+      # An earlier include path now has its own extra.inc.
+      write_dep(os.path.join(first_path, 'extra.inc'), 2, 'kExtra')
+      status, _, smx = server.compile(plugin_path)
+      expect('shadowing include', status, 'ok')
+      if smx == resized:
+        raise Exception('shadowing include produced the same binary')
+    finally:
+      server.close()
+
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main())
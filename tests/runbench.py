@@ -0,0 +1,141 @@
+# vim: set ts=2 sw=2 tw=99 et:
+import argparse
+import json
+import os
+import sys
+
+import testutil
+from runtests import TestPlan
+
+# Compiles every benchmark in tests/bench and times its public "bench"
+# function with each spshell found in the build folder (JIT and interpreter),
+# printing one JSON document with all results. With --jit, times JIT
+# compilation and code patching instead, using only JIT-enabled shells.
+#
+# With --compare-spcomp-arg, every benchmark is also compiled and run with the
+# given extra spcomp arguments (for example --no-fuse), and the report gains a
+# "comparisons" list with the ratio of the two minimum times.
+
+# Returns the minimum time reported by a spshell run, for comparisons.
+def min_time(result):
+  return result['compile_min_ns'] if 'compile_min_ns' in result else result['min_ns']
+
+def run_benchmarks(args, spcomp, shells, bench_path, spcomp_args, temp_folder):
+  tests_path = os.path.dirname(bench_path)
+  core_include_path = os.path.join(os.path.dirname(tests_path), 'include')
+
+  results = []
+  for name in sorted(os.listdir(bench_path)):
+    if not name.endswith('.sp'):
+      continue
+    if args.filter and args.filter not in name:
+      continue
+
+    smx_path = os.path.join(temp_folder, name[:-3] + '.smx')
+    argv = [spcomp['path'], '-i', core_include_path, '-i', tests_path, '-o', smx_path]
+    argv += spcomp_args
+    argv += [os.path.join(bench_path, name)]
+    rc, stdout, stderr = testutil.exec_argv(argv)
+    if rc != 0:
+      raise Exception('Failed to compile {0}:\n{1}{2}'.format(name, stdout, stderr))
+
+    for shell in shells:
+      argv = [shell['path']] + shell['args'] + args.shell_args + [
+        '--bench-jit' if args.jit else '--bench',
+        '--bench-iterations', str(args.iterations),
+        '--bench-samples', str(args.samples),
+        smx_path,
+      ]
+      rc, stdout, stderr = testutil.exec_argv(argv)
+      if rc != 0:
+        raise Exception('Failed to run {0} ({1}):\n{2}{3}'.format(name, shell['name'],
+                                                                stdout, stderr))
+
+      result = json.loads(stdout)
+      result['benchmark'] = name[:-3]
+      result['shell'] = shell['name']
+      result['shell_args'] = args.shell_args
+      result['spcomp_args'] = spcomp_args
+      results.append(result)
+  return results
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('objdir', type=str, help='Build folder to benchmark.')
+  parser.add_argument('--arch', type=str, default=None,
+                      help="Force a specific arch on dual-arch builds.")
+  parser.add_argument('--filter', default=None, type=str,
+                      help='Only run benchmarks with a particular name.')
+  parser.add_argument('--iterations', default=1000, type=int,
+                      help='Calls to "bench" per sample.')
+  parser.add_argument('--samples', default=10, type=int,
+                      help='Number of samples per benchmark.')
+  parser.add_argument('--output', default=None, type=str,
+                      help='Write results to a file instead of stdout.')
+  parser.add_argument('--shell-arg', default=[], type=str, action='append', dest='shell_args',
+                      help='Add an extra argument to all spshell invocations.')
+  parser.add_argument('--spcomp-arg', default=[], type=str, action='append', dest='spcomp_args',
+                      help='Add an extra argument to all spcomp invocations.')
+  parser.add_argument('--compare-spcomp-arg', default=[], type=str, action='append',
+                      dest='compare_args',
+                      help='Also run every benchmark with this extra spcomp argument, and '
+                           'report the ratio of the two times.')
+  parser.add_argument('--jit', default=False, action='store_true',
+                      help='Time JIT compilation and code patching (spshell --bench-jit).')
+  args = parser.parse_args()
+
+  tests_path = os.path.dirname(os.path.abspath(__file__))
+  bench_path = os.path.join(tests_path, 'bench')
+
+  plan = TestPlan(argparse.Namespace(objdir = args.objdir, test = bench_path, arch = args.arch,
+                                     coverage = None, spcomp2 = False, spcomp_args = None))
+  plan.find_spcomp()
+  plan.find_shells()
+  if not len(plan.modes):
+    raise Exception('No compiler binaries were found in {0}'.format(args.objdir))
+  if not len(plan.shells):
+    raise Exception('No spshell binaries were found in {0}'.format(args.objdir))
+  spcomp = plan.modes[0]['spcomp']
+
+  shells = plan.shells
+  if args.jit:
+    shells = [shell for shell in shells if '--disable-jit' not in shell['args']]
+    if not len(shells):
+      raise Exception('No JIT-enabled spshell binaries were found in {0}'.format(args.objdir))
+
+  report = {}
+  with testutil.TempFolder() as temp_folder:
+    try:
+      results = run_benchmarks(args, spcomp, shells, bench_path, args.spcomp_args, temp_folder)
+      report['results'] = results
+      if args.compare_args:
+        compared = run_benchmarks(args, spcomp, shells, bench_path,
+                                  args.spcomp_args + args.compare_args, temp_folder)
+        report['compared_results'] = compared
+    except Exception as e:
+      sys.stderr.write('{0}\n'.format(e))
+      return 1
+
+  # Ratios above 1 mean the extra arguments made the benchmark slower.
+  if args.compare_args:
+    report['comparisons'] = []
+    for base, other in zip(results, compared):
+      report['comparisons'].append({
+        'benchmark': base['benchmark'],
+        'shell': base['shell'],
+        'compare_args': args.compare_args,
+        'min_ns': min_time(base),
+        'compared_min_ns': min_time(other),
+        'ratio': min_time(other) / min_time(base),
+      })
+
+  text = json.dumps(report, indent = 2)
+  if args.output:
+    with open(args.output, 'w') as fp:
+      fp.write(text + '\n')
+  else:
+    print(text)
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,205 @@
+# vim: set ts=2 sw=2 tw=99 et:
+import argparse
+import json
+import os
+import sys
+import time
+
+import testutil
+from runtests import TestPlan
+
+# Measures front-end throughput by compiling a plugin that only includes
+# sourcemod.inc (and everything it pulls in), which is dominated by lexing and
+# macro expansion. Each sample reads the "parse" phase from spcomp's
+# --time-phases-json report; the result is printed as one JSON document.
+#
+# With --macros, the plugin is instead a long function made of nested
+# function-like macro uses, so that argument skimming and substitution
+# dominate.
+#
+# With --batch, the plugin is compiled N times by separate spcomp processes and
+# then N times by a single spcomp given N copies of it, which reads each
+# include once and shares it between jobs. Both are wall-clock times, since
+# process startup is part of what a batch saves.
+kPlugin = """
+#include <sourcemod>
+
+public void OnPluginStart() {
+  PrintToServer("%d", MAXPLAYERS);
+}
+"""
+
+kMacroHeader = """
+#define ADD3(%1,%2,%3) ((%1) + (%2) + (%3))
+#define CLAMP(%1,%2,%3) ((%1) < (%2) ? (%2) : ((%1) > (%3) ? (%3) : (%1)))
+#define SCALE(%1,%2) ((%1) * (%2) / 100)
+
+public int main() {
+  int total = 0;
+"""
+
+kMacroLine = "  total += ADD3(total, CLAMP(SCALE(total, {0}), 0, {1}), SCALE({0}, total));\n"
+
+def macro_plugin(lines):
+  text = kMacroHeader
+  for i in range(lines):
+    text += kMacroLine.format(i % 97, i % 1009)
+  return text + "  return total;\n}\n"
+
+def find_spcomp(objdir, arch):
+  tests_path = os.path.dirname(os.path.abspath(__file__))
+  plan = TestPlan(argparse.Namespace(objdir = objdir, test = tests_path, arch = arch,
+                                     coverage = None, spcomp2 = False, spcomp_args = None))
+  plan.find_spcomp()
+  if not len(plan.modes):
+    raise Exception('No compiler binaries were found in {0}'.format(objdir))
+  return plan.modes[0]['spcomp']['path']
+
+def sp_include_path():
+  tests_path = os.path.dirname(os.path.abspath(__file__))
+  return os.path.join(tests_path, 'sourcemod', 'include')
+
+# Returns the sorted "parse" phase times, in milliseconds, of |samples| compiles.
+def time_parse(spcomp_path, plugin, samples, temp_folder):
+  sp_path = os.path.join(temp_folder, 'lexbench.sp')
+  smx_path = os.path.join(temp_folder, 'lexbench.smx')
+  json_path = os.path.join(temp_folder, 'phases.json')
+  with open(sp_path, 'w') as fp:
+    fp.write(plugin)
+
+  times = []
+  for _ in range(samples):
+    argv = [spcomp_path, '-i', sp_include_path(), '-o', smx_path,
+            '--time-phases-json', json_path, sp_path]
+    rc, stdout, stderr = testutil.exec_argv(argv)
+    if rc != 0:
+      raise Exception('Failed to compile benchmark:\n{0}{1}'.format(stdout, stderr))
+
+    with open(json_path, 'r') as fp:
+      report = json.load(fp)
+    for phase in report['phases']:
+      if phase['name'] == 'parse':
+        times.append(phase['ms'])
+  return sorted(times)
+
+# Returns the sorted wall-clock times, in milliseconds, of compiling |copies|
+# copies of |plugin| either one process at a time or as a single batch.
+def time_batch(spcomp_path, plugin, copies, samples, batched, temp_folder):
+  sp_paths = []
+  for i in range(copies):
+    sp_path = os.path.join(temp_folder, 'lexbench{0}.sp'.format(i))
+    with open(sp_path, 'w') as fp:
+      fp.write(plugin)
+    sp_paths.append(sp_path)
+
+  if batched:
+    invocations = [['-j', '1', '-o', temp_folder] + sp_paths]
+  else:
+    invocations = [['-o', os.path.splitext(sp_path)[0] + '.smx', sp_path] for sp_path in sp_paths]
+
+  times = []
+  for _ in range(samples):
+    start = time.perf_counter()
+    for args in invocations:
+      rc, stdout, stderr = testutil.exec_argv([spcomp_path, '-i', sp_include_path()] + args)
+      if rc != 0:
+        raise Exception('Failed to compile benchmark:\n{0}{1}'.format(stdout, stderr))
+    times.append((time.perf_counter() - start) * 1000.0)
+  return sorted(times)
+
+def summarize(spcomp_path, times, input_bytes):
+  median = times[len(times) // 2]
+  return {
+    'compiler': spcomp_path,
+    'samples_ms': times,
+    'min_ms': times[0],
+    'median_ms': median,
+    'mb_per_sec': (input_bytes / (1024.0 * 1024.0)) / (median / 1000.0),
+  }
+
+def run_batch(args, plugin, input_bytes):
+  spcomp_path = find_spcomp(args.objdir, args.arch)
+  with testutil.TempFolder() as temp_folder:
+    try:
+      separate = time_batch(spcomp_path, plugin, args.batch, args.samples, False, temp_folder)
+      batched = time_batch(spcomp_path, plugin, args.batch, args.samples, True, temp_folder)
+    except Exception as e:
+      sys.stderr.write('{0}\n'.format(e))
+      return 1
+
+  result = {
+    'compiler': spcomp_path,
+    'copies': args.batch,
+    'input_bytes': input_bytes * args.batch,
+    'separate': summarize(spcomp_path, separate, input_bytes * args.batch),
+    'batched': summarize(spcomp_path, batched, input_bytes * args.batch),
+  }
+  result['speedup'] = result['separate']['median_ms'] / result['batched']['median_ms']
+  write_result(args, result)
+  return 0
+
+def write_result(args, result):
+  text = json.dumps(result, indent = 2)
+  if args.output:
+    with open(args.output, 'w') as fp:
+      fp.write(text + '\n')
+  else:
+    print(text)
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('objdir', type=str, help='Build folder to benchmark.')
+  parser.add_argument('--arch', type=str, default=None,
+                      help="Force a specific arch on dual-arch builds.")
+  parser.add_argument('--baseline', type=str, default=None,
+                      help='Another build folder to compare against.')
+  parser.add_argument('--samples', default=20, type=int,
+                      help='Number of compiles to time.')
+  parser.add_argument('--macros', default=None, type=int, metavar='LINES',
+                      help='Time a generated plugin with this many lines of macro uses instead.')
+  parser.add_argument('--batch', default=None, type=int, metavar='N',
+                      help='Compare N separate compiles against one batch compile of N copies.')
+  parser.add_argument('--output', default=None, type=str,
+                      help='Write results to a file instead of stdout.')
+  args = parser.parse_args()
+
+  if args.macros:
+    plugin = macro_plugin(args.macros)
+    input_bytes = len(plugin)
+  else:
+    plugin = kPlugin
+    input_bytes = 0
+    for root, _, files in os.walk(sp_include_path()):
+      for name in files:
+        if name.endswith('.inc'):
+          input_bytes += os.path.getsize(os.path.join(root, name))
+
+  spcomp_path = find_spcomp(args.objdir, args.arch)
+  baseline_path = find_spcomp(args.baseline, args.arch) if args.baseline else None
+
+  if args.batch:
+    return run_batch(args, plugin, input_bytes)
+
+  with testutil.TempFolder() as temp_folder:
+    try:
+      result = summarize(spcomp_path,
+                         time_parse(spcomp_path, plugin, args.samples, temp_folder),
+                         input_bytes)
+      if baseline_path:
+        baseline = summarize(baseline_path,
+                             time_parse(baseline_path, plugin, args.samples, temp_folder),
+                             input_bytes)
+    except Exception as e:
+      sys.stderr.write('{0}\n'.format(e))
+      return 1
+
+  result['input_bytes'] = input_bytes
+  if baseline_path:
+    result['baseline'] = baseline
+    result['speedup'] = baseline['median_ms'] / result['median_ms']
+
+  write_result(args, result)
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main())
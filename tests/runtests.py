@@ -7,6 +7,7 @@ import platform
 import re
 import sys
 
+import smxfile
 import testutil
 from testutil import manifest_get
 
@@ -251,6 +252,10 @@ class Test(object):
     'force_new_parser',
     'force_old_parser',
     'returnCode',
+    'shell_args',
+    'smx_code_features',
+    'smx_max_data_size',
+    'smx_max_stored_data',
     'type',
     'warnings_are_errors',
   ])
@@ -353,6 +358,26 @@ class Test(object):
 
     return []
 
+  @property
+  def shell_args(self):
+    return self.local_manifest_.get('shell_args', '').split()
+
+  @property
+  def max_data_size(self):
+    if 'smx_max_data_size' in self.local_manifest_:
+      return int(self.local_manifest_['smx_max_data_size'])
+    return None
+
+  @property
+  def max_stored_data(self):
+    if 'smx_max_stored_data' in self.local_manifest_:
+      return int(self.local_manifest_['smx_max_stored_data'])
+    return None
+
+  @property
+  def code_features(self):
+    return self.local_manifest_.get('smx_code_features', '').split()
+
   def should_run(self, mode):
     compiler = self.local_manifest_.get('compiler', None)
     if compiler is None:
@@ -478,6 +503,9 @@ class TestRunner(object):
         self.out_io(stderr, stdout)
         return False
 
+      if not self.check_image(test):
+        return False
+
     # Run all shells we found.
     return self.run_shells(mode, test)
 
@@ -519,6 +547,25 @@ class TestRunner(object):
     # Run and return output.
     return self.do_exec(argv, env = mode['spcomp']['env'])
 
+  def check_image(self, test):
+    if test.max_data_size is None and test.max_stored_data is None and not test.code_features:
+      return True
+
+    smx = smxfile.SmxFile(test.smx_path)
+    if test.max_data_size is not None and smx.data_size > test.max_data_size:
+      self.out("FAIL: Data section is {0} bytes, expected at most {1}.".format(
+        smx.data_size, test.max_data_size))
+      return False
+    if test.max_stored_data is not None and smx.stored_data_size > test.max_stored_data:
+      self.out("FAIL: Image stores {0} bytes of data, expected at most {1}.".format(
+        smx.stored_data_size, test.max_stored_data))
+      return False
+    for feature in test.code_features:
+      if not (smx.code_features & smxfile.kCodeFeatures[feature]):
+        self.out("FAIL: Code feature '{0}' is not set.".format(feature))
+        return False
+    return True
+
   def run_shells(self, mode, test):
     for shell in self.plan.shells:
       if not self.run_shell(mode, shell, test):
@@ -527,7 +574,7 @@ class TestRunner(object):
 
   def run_shell(self, mode, shell, test):
     self.out("Running with shell ({0})".format(shell['name']))
-    argv = [shell['path']] + shell['args']
+    argv = [shell['path']] + shell['args'] + test.shell_args
     argv += [self.fix_path(shell['path'], test.smx_path)]
 
     rc, stdout, stderr = self.do_exec(argv, shell['env'])
@@ -0,0 +1,50 @@
+# vim: set ts=2 sw=2 tw=99 et:
+import struct
+import zlib
+
+# Just enough of an .smx reader for the test harness to check what the
+# compiler put in an image. See include/smx/smx-headers.h for the layout.
+
+kMagic = 0x53504646
+kCompressionGz = 1
+
+kCodeFeatures = {
+  'direct-arrays': 1 << 1,
+  'heap-scopes': 1 << 2,
+  'null-functions': 1 << 3,
+  'zero-filled-data': 1 << 4,
+}
+
+class SmxFile(object):
+  def __init__(self, path):
+    with open(path, 'rb') as fp:
+      image = fp.read()
+
+    magic, _, compression, disksize, _, sections, stringtab, dataoffs = \
+      struct.unpack_from('<IHBIIBII', image, 0)
+    if magic != kMagic:
+      raise Exception('{0} is not an .smx file'.format(path))
+    if compression == kCompressionGz:
+      image = image[:dataoffs] + zlib.decompress(image[dataoffs:disksize])
+
+    self.sections = {}
+    for i in range(sections):
+      nameoffs, offset, size = struct.unpack_from('<III', image, 24 + i * 12)
+      name_start = stringtab + nameoffs
+      name = image[name_start:image.index(b'\0', name_start)].decode('utf-8')
+      self.sections[name] = image[offset:offset + size]
+
+  @property
+  def code_features(self):
+    return struct.unpack_from('<I', self.sections['.code'], 16)[0]
+
+  # Size of the data section once loaded, including zeroes that are not stored.
+  @property
+  def data_size(self):
+    return struct.unpack_from('<III', self.sections['.data'], 0)[0]
+
+  # Bytes of the data section actually stored in the image.
+  @property
+  def stored_data_size(self):
+    _, _, data = struct.unpack_from('<III', self.sections['.data'], 0)
+    return len(self.sections['.data']) - data
@@ -45,6 +45,8 @@ def main():
                         help = "Number of test worker slices (for CI).")
     parser.add_argument("--slice", default = 0, type = int,
                         help = "Which slice of tests to run, starting at 1.")
+    parser.add_argument("--stats", default = False, action = 'store_true',
+                        help = "Aggregate spcomp --show-stats code generation totals and peak memory")
 
     args = parser.parse_args()
 
@@ -97,6 +99,8 @@ class Runner(object):
         self.missing_includes_ = {}
         self.log_ = sys.stderr
         self.failed_ = 0
+        self.stats_ = {}
+        self.peak_memory_ = (0, None)
 
         self.includes_ = [os.path.join(self.args_.corpus, 'include')]
         self.includes_.extend(args.include)
@@ -139,6 +143,12 @@ class Runner(object):
         for include, encounters in missing:
             print("Missing include {} used {} times.".format(include, encounters))
 
+        if self.args_.stats:
+            for key, value in sorted(self.stats_.items()):
+                print("{:<20} {}".format(key + ":", value))
+            if self.peak_memory_[1]:
+                print("{:<20} {} bytes ({})".format("Peak memory:", *self.peak_memory_))
+
         # Re-sort the skip list.
         if self.skip_set_ and self.args_.commit:
             with open(self.skip_file_path_, 'wt') as fp:
@@ -206,11 +216,14 @@ class Runner(object):
                 output_file += '.smx'
 
             argv += ['-o', output_file]
+            if self.args_.stats:
+                argv += ['--show-stats']
 
             ok = False
             output = None
             try:
-                subprocess.check_output(argv, stderr = subprocess.STDOUT, timeout = 10)
+                output = subprocess.check_output(argv, stderr = subprocess.STDOUT, timeout = 10)
+                output = output.decode('utf-8', errors = 'ignore')
                 ok = True
             except KeyboardInterrupt:
                 raise
@@ -281,6 +294,8 @@ class Runner(object):
                 include = m.group(1)
                 self.missing_includes_[include] = self.missing_includes_.get(include, 0) + 1
         else:
+            if self.args_.stats:
+                self.collect_stats(path, output)
             if self.args_.remove_good:
                 self.log_.write("rm \"{}\"".format(path) + "\n")
                 if self.args_.commit:
@@ -291,6 +306,25 @@ class Runner(object):
         if remove:
             self.skip_set_.add(path)
 
+    def collect_stats(self, path, output):
+        in_codegen = False
+        for line in output.split('\n'):
+            m = re.match(r"Peak memory:\s+(\d+)", line)
+            if m is not None:
+                if int(m.group(1)) > self.peak_memory_[0]:
+                    self.peak_memory_ = (int(m.group(1)), path)
+                continue
+            if line.startswith(' -- '):
+                in_codegen = 'Code generation' in line
+                continue
+            if not in_codegen:
+                continue
+            m = re.match(r"([A-Za-z ]+):\s+(\d+)", line)
+            if m is None:
+                continue
+            key = m.group(1).strip()
+            self.stats_[key] = self.stats_.get(key, 0) + int(m.group(2))
+
 def diagnose_error(path, output):
     print("Error compiling {}:".format(path))
     print("")
@@ -79,7 +79,7 @@ SourcePawnEngine::ExecAlloc(size_t size)
 void*
 SourcePawnEngine::AllocatePageMemory(size_t size)
 {
-  CodeChunk chunk = Environment::get()->AllocateCode(size + sizeof(CodeChunk));
+  CodeChunk chunk = Environment::get()->AllocateHostCode(size + sizeof(CodeChunk));
   CodeChunk* hidden = (CodeChunk*)chunk.address();
   new (hidden) CodeChunk(chunk);
   return hidden + 1;
@@ -11,25 +11,37 @@
 // SourcePawn. If not, see http://www.gnu.org/licenses/.
 //
 #include <assert.h>
+#include <mutex>
 #include "code-allocator.h"
+#include "environment.h"
 #if defined(_WIN32)
 # include <Windows.h>
 #else
 # include <unistd.h>
 # include <sys/mman.h>
 #endif
+#if defined(__linux__)
+# include <sys/syscall.h>
+#endif
 #include <amtl/am-bits.h>
 
 using namespace sp;
 
 static const size_t kMaxCachedPools = 8;
 
-CodeAllocator::CodeAllocator()
+CodeAllocator::CodeAllocator(size_t min_pool_size, bool dual_map)
+ : min_pool_size_(min_pool_size),
+   dual_map_(dual_map)
 {
 }
 
 CodeAllocator::~CodeAllocator()
 {
+  cached_pools_.clear();
+
+  // Any pools still alive are kept by code that outlives us.
+  for (CodePool* pool : live_pools_)
+    pool->allocator_ = nullptr;
 }
 
 CodeChunk
@@ -39,16 +51,26 @@ CodeAllocator::Allocate(size_t rawBytes)
   if (bytes < rawBytes)
     return CodeChunk();
 
+  // An evicted pool may die on return, and poolDestroyed takes the lock
+  // itself, so it must be released outside of the locked region.
+  RefPtr<CodePool> evicted;
+
+  // Environment::GetCodeSpaceStats reads each pool's bump pointer and walks
+  // the live and cached pools under the environment lock, possibly from
+  // another thread, so the whole allocation happens under it.
+  std::lock_guard<ke::Mutex> lock(Environment::get()->lock());
+
   // First search the cache for any pools we can re-use.
   RefPtr<CodePool> pool = findPool(bytes);
   if (pool)
     return allocateInPool(pool, bytes);
 
-  pool = CodePool::AllocateFor(bytes);
+  pool = CodePool::AllocateFor(this, bytes, min_pool_size_);
   if (!pool)
     return CodeChunk();
 
   CodeChunk chunk = allocateInPool(pool, bytes);
+  live_pools_.push_back(pool.get());
 
   // Enter this pool into the cache if we can.
   if (cached_pools_.size() < kMaxCachedPools) {
@@ -61,8 +83,10 @@ CodeAllocator::Allocate(size_t rawBytes)
       if (cached_pools_[i]->bytesFree() < cached_pools_[min_index]->bytesFree())
         min_index = i;
     }
-    if (cached_pools_[min_index]->bytesFree() < pool->bytesFree())
+    if (cached_pools_[min_index]->bytesFree() < pool->bytesFree()) {
+      evicted = cached_pools_[min_index];
       cached_pools_[min_index] = pool;
+    }
   }
 
   return chunk;
@@ -88,14 +112,61 @@ CodeChunk
 CodeAllocator::allocateInPool(RefPtr<CodePool> pool, size_t bytes)
 {
   uint8_t* address = pool->allocate(bytes);
-  return CodeChunk(pool, address, bytes);
+  return CodeChunk(pool, address, bytes, pool->writeDelta());
+}
+
+uint8_t*
+CodeAllocator::WritableAddress(void* address) const
+{
+  std::lock_guard<ke::Mutex> lock(Environment::get()->lock());
+  uint8_t* exec = reinterpret_cast<uint8_t*>(address);
+  for (CodePool* pool : live_pools_) {
+    if (pool->contains(exec))
+      return exec + pool->writeDelta();
+  }
+  assert(false);
+  return exec;
+}
+
+void
+CodeAllocator::poolDestroyed(CodePool* pool)
+{
+  std::lock_guard<ke::Mutex> lock(Environment::get()->lock());
+  for (size_t i = 0; i < live_pools_.size(); i++) {
+    if (live_pools_[i] == pool) {
+      live_pools_[i] = live_pools_.back();
+      live_pools_.pop_back();
+      return;
+    }
+  }
+  assert(false);
+}
+
+void
+CodeAllocator::AddStats(CodeSpaceStats* stats) const
+{
+  Environment::get()->lock().AssertCurrentThreadOwns();
+  for (CodePool* pool : live_pools_) {
+    stats->pools++;
+    stats->reserved_bytes += pool->size_;
+    stats->used_bytes += pool->bytesUsed();
+
+    bool cached = false;
+    for (const auto& cached_pool : cached_pools_) {
+      if (cached_pool.get() == pool) {
+        cached = true;
+        break;
+      }
+    }
+    if (!cached)
+      stats->stranded_bytes += pool->bytesFree();
+  }
 }
 
 static size_t kPageGranularity = 0;
-static size_t kMinPoolSize = 1 * kMB;
 
 RefPtr<CodePool>
-CodePool::AllocateFor(size_t askBytes)
+CodePool::AllocateFor(CodeAllocator* allocator, size_t askBytes, size_t min_size)
 {
   if (!kPageGranularity) {
     // On Windows, the page granularity is defined as 64KB. On POSIX systems it's
@@ -112,8 +183,8 @@ CodePool::AllocateFor(size_t askBytes)
 
   // If the allocation is larger than our minimum pool size, we only align up
   // to the page granularity.
-  size_t bytes = (askBytes < kMinPoolSize)
-                 ? kMinPoolSize
+  size_t bytes = (askBytes < min_size)
+                 ? ke::Align(min_size, kPageGranularity)
                  : ke::Align(askBytes, kPageGranularity);
   assert(ke::IsAligned(bytes, kPageGranularity));
 
@@ -121,17 +192,66 @@ CodePool::AllocateFor(size_t askBytes)
   void* address = (uint8_t* )VirtualAlloc(nullptr, bytes, MEM_COMMIT|MEM_RESERVE, PAGE_EXECUTE_READWRITE);
   if (!address)
     return nullptr;
+  uint8_t* writable = (uint8_t*)address;
 #else
-  void* address = mmap(nullptr, bytes, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_PRIVATE|MAP_ANON, -1, 0);
-  if (address == MAP_FAILED)
-    return nullptr;
+  uint8_t* address;
+  uint8_t* writable;
+  if (!allocator->dual_map_ || !MapDualView(bytes, &address, &writable)) {
+    // Fall back to a single RWX mapping if the kernel won't give us a
+    // shareable anonymous file.
+    void* rwx = mmap(nullptr, bytes, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_PRIVATE|MAP_ANON, -1, 0);
+    if (rwx == MAP_FAILED)
+      return nullptr;
+    address = writable = (uint8_t*)rwx;
+  }
 #endif
 
-  return new CodePool((uint8_t*)address, bytes);
+  return new CodePool(allocator, (uint8_t*)address, writable, bytes);
 }
 
-CodePool::CodePool(uint8_t* start, size_t size)
- : start_(start),
+// Map one anonymous file twice: read+execute for running code, and
+// read+write for emitting and patching it. Since both views share the same
+// pages, writes are visible to the executable view immediately, and we never
+// need to flip page permissions.
+bool
+CodePool::MapDualView(size_t bytes, uint8_t** exec, uint8_t** writable)
+{
+#if defined(__linux__) && defined(SYS_memfd_create)
+  int fd = (int)syscall(SYS_memfd_create, "sourcepawn-jit", 0);
+  if (fd < 0)
+    return false;
+  if (ftruncate(fd, bytes) != 0) {
+    close(fd);
+    return false;
+  }
+
+  void* rx = mmap(nullptr, bytes, PROT_READ|PROT_EXEC, MAP_SHARED, fd, 0);
+  if (rx == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  void* rw = mmap(nullptr, bytes, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if (rw == MAP_FAILED) {
+    munmap(rx, bytes);
+    close(fd);
+    return false;
+  }
+
+  // The mappings keep the file alive.
+  close(fd);
+
+  *exec = (uint8_t*)rx;
+  *writable = (uint8_t*)rw;
+  return true;
+#else
+  return false;
+#endif
+}
+
+CodePool::CodePool(CodeAllocator* allocator, uint8_t* start, uint8_t* writable, size_t size)
+ : allocator_(allocator),
+   start_(start),
+   writable_(writable),
    ptr_(start),
    end_(start + size),
    size_(size)
@@ -140,9 +260,14 @@ CodePool::CodePool(uint8_t* start, size_t size)
 
 CodePool::~CodePool()
 {
+  if (allocator_)
+    allocator_->poolDestroyed(this);
+
 #if defined(_WIN32)
   VirtualFree(start_, 0, MEM_RELEASE);
 #else
+  if (writable_ != start_)
+    munmap(writable_, size_);
   munmap(start_, size_);
 #endif
 }
@@ -22,6 +22,8 @@ namespace sp {
 
 using namespace ke;
 
+class CodeAllocator;
+
 // Manages CodeChunks, optimized for the underlying system allocator.
 class CodePool : public ke::Refcounted<CodePool>
 {
@@ -31,21 +33,38 @@ class CodePool : public ke::Refcounted<CodePool>
   ~CodePool();
 
  private:
-  CodePool(uint8_t* start, size_t size);
+  CodePool(CodeAllocator* allocator, uint8_t* start, uint8_t* writable, size_t size);
 
-  static RefPtr<CodePool> AllocateFor(size_t bytes);
+  static RefPtr<CodePool> AllocateFor(CodeAllocator* allocator, size_t bytes, size_t min_size);
+  static bool MapDualView(size_t bytes, uint8_t** exec, uint8_t** writable);
 
   uint8_t* allocate(size_t bytes);
   size_t bytesFree() const {
     return end_ - ptr_;
   }
+  size_t bytesUsed() const {
+    return ptr_ - start_;
+  }
+  bool contains(const uint8_t* address) const {
+    return address >= start_ && address < end_;
+  }
+  ptrdiff_t writeDelta() const {
+    return writable_ - start_;
+  }
 
  private:
   CodePool(const CodePool&) = delete;
   void operator =(const CodePool&) = delete;
 
  private:
+  // Cleared if the allocator goes away before the pool does.
+  CodeAllocator* allocator_;
   uint8_t* start_;
+  // Writable view of the pool. If the pool is dual-mapped, |start_| is
+  // mapped read+execute and this is a separate read+write mapping of the
+  // same memory. Otherwise the pool is read+write+execute and this equals
+  // |start_|.
+  uint8_t* writable_;
   uint8_t* ptr_;
   uint8_t* end_;
   size_t size_;
@@ -56,14 +75,17 @@ struct CodeChunk
 {
   CodeChunk()
    : address_(nullptr),
-     bytes_(0)
+     bytes_(0),
+     write_delta_(0)
   {}
-  CodeChunk(RefPtr<CodePool> pool, uint8_t* address, size_t bytes)
+  CodeChunk(RefPtr<CodePool> pool, uint8_t* address, size_t bytes, ptrdiff_t write_delta)
    : pool_(pool),
      address_(address),
-     bytes_(bytes)
+     bytes_(bytes),
+     write_delta_(write_delta)
   {}
 
+  // Executable address of the code.
   uint8_t* address() const {
     return address_;
   }
@@ -71,32 +93,86 @@ struct CodeChunk
     return bytes_;
   }
 
+  // Translate an address inside this chunk to one that can be written to.
+  uint8_t* writable(void* address) const {
+    return reinterpret_cast<uint8_t*>(address) + write_delta_;
+  }
+  uint8_t* writable() const {
+    return writable(address_);
+  }
+
  private:
   RefPtr<CodePool> pool_;
   uint8_t* address_;
   size_t bytes_;
+  ptrdiff_t write_delta_;
+};
+
+// Summary of the executable memory held by one or more allocators.
+struct CodeSpaceStats
+{
+  CodeSpaceStats()
+   : pools(0),
+     reserved_bytes(0),
+     used_bytes(0),
+     stranded_bytes(0)
+  {}
+
+  // Number of live pools.
+  size_t pools;
+  // Total size of all live pools.
+  size_t reserved_bytes;
+  // Bytes handed out to code, including code that has since died but whose
+  // pool is still alive.
+  size_t used_bytes;
+  // Free bytes in pools that were evicted from the cache. These can never
+  // be allocated again, and are freed only when the whole pool dies.
+  size_t stranded_bytes;
 };
 
 // Manages CodePools.
 class CodeAllocator
 {
+  friend class CodePool;
+
  public:
-  CodeAllocator();
+  static const size_t kDefaultMinPoolSize = 1024 * 1024;
+
+  // If |dual_map| is true, pools are mapped twice where the platform allows,
+  // so that no page is ever writable and executable at once. Code must then
+  // be written through CodeChunk::writable() or WritableAddress().
+  explicit CodeAllocator(size_t min_pool_size = kDefaultMinPoolSize, bool dual_map = false);
   ~CodeAllocator();
 
   CodeChunk Allocate(size_t bytes);
 
+  // Translate an executable address from any live pool of this allocator to
+  // a writable one.
+  uint8_t* WritableAddress(void* address) const;
+
+  // Add the pools owned by this allocator to |stats|. The caller must own the
+  // environment lock.
+  void AddStats(CodeSpaceStats* stats) const;
+
  private:
   RefPtr<CodePool> newPool(size_t bytes);
   RefPtr<CodePool> findPool(size_t bytes);
   CodeChunk allocateInPool(RefPtr<CodePool> pool, size_t bytes);
+  void poolDestroyed(CodePool* pool);
 
  private:
   CodeAllocator(const CodeAllocator&) = delete;
   void operator =(const CodeAllocator&) = delete;
 
  private:
+  size_t min_pool_size_;
+  bool dual_map_;
+  // Changes to these, and to the bump pointers of their pools, are made under
+  // the environment lock, so that AddStats can run on another thread.
   std::vector<RefPtr<CodePool>> cached_pools_;
+
+  // Every live pool created by this allocator, cached or not.
+  std::vector<CodePool*> live_pools_;
 };
 
 } // namespace sp
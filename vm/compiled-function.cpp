@@ -19,11 +19,13 @@ using namespace sp;
 CompiledFunction::CompiledFunction(const CodeChunk& code,
                                    cell_t pcode_offs,
                                    FixedArray<LoopEdge>* edges,
-                                   FixedArray<CipMapEntry>* cipmap)
+                                   FixedArray<CipMapEntry>* cipmap,
+                                   FixedArray<DebugBreakSite>* debug_breaks)
  : code_(code),
    code_offset_(pcode_offs),
    edges_(edges),
    cip_map_(cipmap),
+   debug_breaks_(debug_breaks),
    cip_map_sorted_(false)
 {
 }
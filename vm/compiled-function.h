@@ -36,6 +36,19 @@ struct LoopEdge
   int32_t disp32;
 };
 
+struct DebugBreakSite
+{
+  // Offset just past the patchable 5-byte site, such that (base + offset - 5)
+  // is the start of either a nop or a call to the debug break handler.
+  uint32_t offset;
+  // The displacement of the call to the debug break handler.
+  int32_t disp32;
+  // The cip of the BREAK opcode, relative to the start of the code section.
+  ucell_t cip;
+  // Whether the site currently calls the handler.
+  bool armed;
+};
+
 struct CipMapEntry {
   // Offset from the first cip of the function.
   uint32_t cipoffs;
@@ -51,13 +64,18 @@ class CompiledFunction
   CompiledFunction(const CodeChunk& code,
                    cell_t pcode_offs,
                    FixedArray<LoopEdge>* edges,
-                   FixedArray<CipMapEntry>* cip_map);
+                   FixedArray<CipMapEntry>* cip_map,
+                   FixedArray<DebugBreakSite>* debug_breaks);
   ~CompiledFunction();
 
  public:
   void* GetEntryAddress() const {
     return code_.address();
   }
+  // Address to use when patching the function's code.
+  uint8_t* GetWritableAddress() const {
+    return code_.writable();
+  }
   cell_t GetCodeOffset() const {
     return code_offset_;
   }
@@ -67,6 +85,12 @@ class CompiledFunction
   LoopEdge& GetLoopEdge(size_t i) {
     return edges_->at(i);
   }
+  uint32_t NumDebugBreaks() const {
+    return debug_breaks_->size();
+  }
+  DebugBreakSite& GetDebugBreak(size_t i) {
+    return debug_breaks_->at(i);
+  }
 
   ucell_t FindCipByPc(void* pc);
 
@@ -75,6 +99,7 @@ class CompiledFunction
   cell_t code_offset_;
   std::unique_ptr<FixedArray<LoopEdge>> edges_;
   std::unique_ptr<FixedArray<CipMapEntry>> cip_map_;
+  std::unique_ptr<FixedArray<DebugBreakSite>> debug_breaks_;
   bool cip_map_sorted_;
 };
 
@@ -19,8 +19,10 @@ namespace sp {
 
 using namespace ke;
 
-ControlFlowGraph::ControlFlowGraph(PluginRuntime* rt, const uint8_t* start_offset)
+ControlFlowGraph::ControlFlowGraph(PluginRuntime* rt, const uint8_t* code,
+                                   const uint8_t* start_offset)
  : rt_(rt),
+   code_(code),
    epoch_(1)
 {
   entry_ = newBlock(start_offset);
@@ -260,6 +262,7 @@ ControlFlowGraph::computeLoopHeaders()
 void
 ControlFlowGraph::dump(FILE* fp)
 {
+  assert(rt_);
   for (RpoIterator iter = rpoBegin(); iter != rpoEnd(); iter++) {
     Block* block = *iter;
     fprintf(fp, "Block %p (%d):\n", block, block->id());
@@ -392,13 +395,13 @@ Block::unlink()
 uint32_t
 Block::startPc() const
 {
-  return start_ - graph_.rt()->code().bytes;
+  return start_ - graph_.code();
 }
 
 uint32_t
 Block::endPc() const
 {
-  return end_ - graph_.rt()->code().bytes;
+  return end_ - graph_.code();
 }
 
 } // namespace sp
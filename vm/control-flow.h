@@ -202,7 +202,8 @@ typedef ke::InlineList<Block>::reverse_iterator PostorderIterator;
 class ControlFlowGraph : public ke::Refcounted<ControlFlowGraph>
 {
  public:
-  explicit ControlFlowGraph(PluginRuntime* rt, const uint8_t* start_offset);
+  // |rt| is only needed by dump(), and may be null.
+  ControlFlowGraph(PluginRuntime* rt, const uint8_t* code, const uint8_t* start_offset);
   ~ControlFlowGraph();
 
   ke::RefPtr<Block> entry() const {
@@ -248,9 +249,11 @@ class ControlFlowGraph : public ke::Refcounted<ControlFlowGraph>
   void dumpDomTreeDot(FILE* fp);
 
   PluginRuntime* rt() const { return rt_; }
+  const uint8_t* code() const { return code_; }
 
  private:
   PluginRuntime* rt_;
+  const uint8_t* code_;
   ke::RefPtr<Block> entry_;
   ke::InlineList<Block> blocks_;
   uint32_t epoch_;
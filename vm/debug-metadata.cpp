@@ -21,6 +21,9 @@ using namespace sp;
 
 #include <unistd.h>
 
+// gettid
+#include <sys/syscall.h>
+
 // clock_gettime
 #include <time.h>
 
@@ -74,6 +77,10 @@ void PerfJitFile::Write(void* address, uint64_t length, const char* symbol) {
 PerfJitdumpFile::PerfJitdumpFile(bool self_delete) {
   pid_ = getpid();
   self_delete_ = self_delete;
+  mmap_ = nullptr;
+  file_ = nullptr;
+  use_arch_timestamp_ = false;
+  next_code_index_ = 0;
 
   // We can keep this file anywhere, but the name must be ".../jit-XXXX.dump", where XXXX is our PID.
   // https://github.com/torvalds/linux/blob/614cb5894306cfa2c7d9b6168182876ff5948735/tools/perf/Documentation/jitdump-specification.txt
@@ -120,10 +127,19 @@ PerfJitdumpFile::~PerfJitdumpFile() {
     return;
   }
 
-  // Write close record?
+  // Tell perf inject that no more records follow.
+  jr_prefix close_record = {};
+  close_record.id = JIT_CODE_CLOSE;
+  close_record.total_size = sizeof(close_record);
+  close_record.timestamp = GetTimestamp();
+  fwrite(&close_record, sizeof(close_record), 1, file_);
 
   fclose(file_);
 
+  if (mmap_) {
+    munmap(mmap_, sysconf(_SC_PAGESIZE));
+  }
+
   if (self_delete_) {
     unlink(path_);
   }
@@ -135,28 +151,42 @@ void PerfJitdumpFile::Write(void* address, uint64_t length, const char* symbol,
   }
 
   if (!mapping.empty()) {
+    // The JIT records a mapping for every opcode, but consecutive opcodes usually come from the
+    // same line. Only keep the entries where the file or line changes; the last entry is always
+    // kept since perf ignores it.
+    std::vector<const CodeDebugMapping*> entries;
+    for (size_t i = 0; i < mapping.size(); i++) {
+      const auto& map = mapping[i];
+      if (!entries.empty() && i != mapping.size() - 1) {
+        const auto* prev = entries.back();
+        if (prev->line == map.line && strcmp(prev->file, map.file) == 0)
+          continue;
+      }
+      entries.push_back(&map);
+    }
+
     jr_code_debug_info dbg_record = {};
     dbg_record.p.id = JIT_CODE_DEBUG_INFO;
     dbg_record.p.total_size = sizeof(dbg_record);
     dbg_record.p.timestamp = GetTimestamp();
     dbg_record.code_addr = (uint64_t)address;
-    dbg_record.nr_entry = mapping.size();
+    dbg_record.nr_entry = entries.size();
 
-    for (const auto& map : mapping) {
-      dbg_record.p.total_size += sizeof(debug_entry) + strlen(map.file) + 1;
+    for (const auto* map : entries) {
+      dbg_record.p.total_size += sizeof(debug_entry) + strlen(map->file) + 1;
     }
 
     fwrite(&dbg_record, sizeof(dbg_record), 1, file_);
 
-    for (const auto& map : mapping) {
+    for (const auto* map : entries) {
       // Our special markers can be identified by them having a line number of 0,
       // perf doesn't like that so we just shift them up to 1 so they're not lost.
       debug_entry entry = {};
-      entry.addr = (uint64_t)address + map.addr;
-      entry.lineno = map.line >= 1 ? map.line : 1;
+      entry.addr = (uint64_t)address + map->addr;
+      entry.lineno = map->line >= 1 ? map->line : 1;
 
       fwrite(&entry, sizeof(entry), 1, file_);
-      fwrite(map.file, 1, strlen(map.file) + 1, file_);
+      fwrite(map->file, 1, strlen(map->file) + 1, file_);
     }
   }
 
@@ -165,11 +195,11 @@ void PerfJitdumpFile::Write(void* address, uint64_t length, const char* symbol,
   record.p.total_size = sizeof(record) + strlen(symbol) + 1 + length;
   record.p.timestamp = GetTimestamp();
   record.pid = pid_;
-  record.tid = pid_; // TODO: Use the thread id.
+  record.tid = GetThreadId();
   record.vma = (uint64_t)address;
   record.code_addr = (uint64_t)address;
   record.code_size = length;
-  record.code_index = (uint64_t)address; // We don't re-JIT, so this should be fine.
+  record.code_index = next_code_index_++;
 
   fwrite(&record, sizeof(record), 1, file_);
   fwrite(symbol, 1, strlen(symbol) + 1, file_);
@@ -192,6 +222,10 @@ uint64_t PerfJitdumpFile::GetTimestamp() {
   return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
 }
 
+uint32_t PerfJitdumpFile::GetThreadId() {
+  return (uint32_t)syscall(SYS_gettid);
+}
+
 uint16_t PerfJitdumpFile::GetElfMachine() {
   uint16_t machine = 0; /* EM_NONE */
 
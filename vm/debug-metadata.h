@@ -58,6 +58,7 @@ class PerfJitdumpFile
  private:
   uint64_t GetTimestamp();
   uint16_t GetElfMachine();
+  uint32_t GetThreadId();
 
  private:
   int pid_;
@@ -68,6 +69,10 @@ class PerfJitdumpFile
 
   // When being used with Intel PT profiling, we need to use the CPU clock as our time source.
   bool use_arch_timestamp_;
+
+  // Code pools are freed and their addresses reused as plugins reload, so every load gets a
+  // unique index. perf inject names the generated objects after it.
+  uint64_t next_code_index_;
 };
 #endif
 
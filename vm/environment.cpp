@@ -36,6 +36,8 @@ static Environment* sEnvironment = nullptr;
 Environment::Environment()
  : debug_break_enabled_(false),
    debug_break_handler_(nullptr),
+   polled_interrupts_(false),
+   fuel_metering_(false),
    debugger_(nullptr),
    eh_top_(nullptr),
    exception_code_(SP_ERROR_NONE),
@@ -87,7 +89,7 @@ Environment::Initialize()
   api_v2_ = std::make_unique<SourcePawnEngine2>();
   watchdog_timer_ = std::make_unique<WatchdogTimer>(this);
   builtins_ = std::make_unique<BuiltinNatives>();
-  code_alloc_ = std::make_unique<CodeAllocator>();
+  code_alloc_ = std::make_unique<CodeAllocator>(CodeAllocator::kDefaultMinPoolSize, true);
 
   if (!builtins_->Initialize())
     return false;
@@ -102,6 +104,7 @@ Environment::Shutdown()
   builtins_ = nullptr;
   code_stubs_ = nullptr;
   code_alloc_ = nullptr;
+  host_code_alloc_ = nullptr;
   PoolAllocator::FreeDefault();
 
   assert(sEnvironment == this);
@@ -125,6 +128,28 @@ Environment::EnableDebugBreak()
   return true;
 }
 
+bool
+Environment::EnablePolledInterrupts()
+{
+  // Can't change this after any plugins are loaded.
+  if (!runtimes_.empty())
+    return false;
+
+  polled_interrupts_ = true;
+  return true;
+}
+
+bool
+Environment::EnableFuelMetering()
+{
+  // Can't change this after any plugins are loaded.
+  if (!runtimes_.empty())
+    return false;
+
+  fuel_metering_ = true;
+  return true;
+}
+
 void
 Environment::SetDebugMetadataFlags(int flags)
 {
@@ -195,7 +220,8 @@ static const char* sErrorMsgTable[] =
   "Integer overflow",
   "Script execution timed out",
   "Custom error",
-  "Fatal error"
+  "Fatal error",
+  "Script execution budget exhausted"
 };
 
 const char*
@@ -212,6 +238,32 @@ Environment::AllocateCode(size_t size)
   return code_alloc_->Allocate(size);
 }
 
+// Embedders write directly into memory from AllocatePageMemory, so it comes
+// from separate read+write+execute pools. Hosts that never ask for it never
+// map such pages.
+CodeChunk
+Environment::AllocateHostCode(size_t size)
+{
+  if (!host_code_alloc_)
+    host_code_alloc_ = std::make_unique<CodeAllocator>();
+  return host_code_alloc_->Allocate(size);
+}
+
+// Sum up the shared pools and every runtime's pools.
+CodeSpaceStats
+Environment::GetCodeSpaceStats()
+{
+  std::lock_guard<ke::Mutex> lock(mutex_);
+
+  CodeSpaceStats stats;
+  code_alloc_->AddStats(&stats);
+  if (host_code_alloc_)
+    host_code_alloc_->AddStats(&stats);
+  for (ke::InlineList<PluginRuntime>::iterator iter = runtimes_.begin(); iter != runtimes_.end(); iter++)
+    (*iter)->code_allocator()->AddStats(&stats);
+  return stats;
+}
+
 void
 Environment::WriteDebugMetadata(void* address, uint64_t length, const char* symbol, const CodeDebugMap& mapping)
 {
@@ -246,6 +298,18 @@ Environment::WriteDebugMetadata(void* address, uint64_t length, const char* symb
 #endif
 }
 
+void
+Environment::SetDebugBreakHandler(SPVM_DEBUGBREAK handler)
+{
+  std::lock_guard<ke::Mutex> lock(mutex_);
+  debug_break_handler_ = handler;
+
+  // Runtimes that have not chosen a single-step mode follow the handler, so
+  // re-arm their break sites.
+  for (ke::InlineList<PluginRuntime>::iterator iter = runtimes_.begin(); iter != runtimes_.end(); iter++)
+    (*iter)->UpdateAllDebugBreaks();
+}
+
 void
 Environment::RegisterRuntime(PluginRuntime* rt)
 {
@@ -282,7 +346,7 @@ Environment::PatchAllJumpsForTimeout()
       if (!fun)
         continue;
 
-      uint8_t* base = reinterpret_cast<uint8_t*>(fun->GetEntryAddress());
+      uint8_t* base = fun->GetWritableAddress();
 
       for (size_t j = 0; j < fun->NumLoopEdges(); j++)
         SwapLoopEdge(base, fun->GetLoopEdge(j));
@@ -303,7 +367,7 @@ Environment::UnpatchAllJumpsFromTimeout()
       if (!fun)
         continue;
 
-      uint8_t* base = reinterpret_cast<uint8_t*>(fun->GetEntryAddress());
+      uint8_t* base = fun->GetWritableAddress();
 
       for (size_t j = 0; j < fun->NumLoopEdges(); j++)
         SwapLoopEdge(base, fun->GetLoopEdge(j));
@@ -469,8 +533,6 @@ void Environment::BlamePluginErrorVA(SourcePawn::IPluginFunction* pf, const char
 void
 Environment::DispatchReport(const ErrorReport& report)
 {
-  FrameIterator iter;
-
   // If this fires, someone forgot to propagate an error.
   assert(!hasPendingException());
 
@@ -481,8 +543,20 @@ Environment::DispatchReport(const ErrorReport& report)
   }
 
   // For now, we always report exceptions even if they might be handled.
-  if (debugger_)
-    debugger_->ReportError(report, iter);
+  // Listeners usually only print the trace, so record it without allocating
+  // and leave symbolizing to them. Very deep stacks use a live iterator.
+  if (debugger_) {
+    static const size_t kMaxCapturedFrames = 64;
+    CapturedFrame frames[kMaxCapturedFrames];
+    size_t nframes = CaptureStackTrace(frames, kMaxCapturedFrames);
+    if (nframes <= kMaxCapturedFrames) {
+      CapturedFrameIterator captured(frames, nframes);
+      debugger_->ReportError(report, captured);
+    } else {
+      FrameIterator iter;
+      debugger_->ReportError(report, iter);
+    }
+  }
 
   // See if the plugin is being debugged
   if (top_)
@@ -72,9 +72,11 @@ class Environment : public ISourcePawnEnvironment
   const char* GetPendingExceptionMessage(const ExceptionHandler* handler) override;
   bool EnableDebugBreak() override;
   void SetDebugMetadataFlags(int flags) override;
+  bool EnablePolledInterrupts() override;
+  bool EnableFuelMetering() override;
 
   // Runtime functions.
-  const char* GetErrorString(int err);
+  static const char* GetErrorString(int err);
   void ReportError(int code);
   void ReportError(int code, const char* message);
   void ReportErrorFmt(int code, const char* message, ...);
@@ -84,6 +86,8 @@ class Environment : public ISourcePawnEnvironment
 
   // Allocate and free executable memory.
   CodeChunk AllocateCode(size_t size);
+  CodeChunk AllocateHostCode(size_t size);
+  CodeSpaceStats GetCodeSpaceStats();
   void WriteDebugMetadata(void* address, uint64_t length, const char* symbol, const CodeDebugMap& mapping);
 
   CodeStubs* stubs() {
@@ -131,9 +135,7 @@ class Environment : public ISourcePawnEnvironment
   bool IsDebugBreakEnabled() const {
     return debug_break_enabled_;
   }
-  void SetDebugBreakHandler(SPVM_DEBUGBREAK handler) {
-    debug_break_handler_ = handler;
-  }
+  void SetDebugBreakHandler(SPVM_DEBUGBREAK handler);
   SPVM_DEBUGBREAK debugbreak() const {
     return debug_break_handler_;
   }
@@ -142,6 +144,13 @@ class Environment : public ISourcePawnEnvironment
     return debug_metadata_flags_;
   }
 
+  bool UsesPolledInterrupts() const {
+    return polled_interrupts_;
+  }
+  bool UsesFuelMetering() const {
+    return fuel_metering_;
+  }
+
   WatchdogTimer* watchdog() const {
     return watchdog_timer_.get();
   }
@@ -198,6 +207,8 @@ class Environment : public ISourcePawnEnvironment
 
   bool debug_break_enabled_;
   SPVM_DEBUGBREAK debug_break_handler_;
+  bool polled_interrupts_;
+  bool fuel_metering_;
 
   IDebugListener* debugger_;
   ExceptionHandler* eh_top_;
@@ -220,6 +231,7 @@ class Environment : public ISourcePawnEnvironment
   bool profiling_enabled_;
 
   std::unique_ptr<CodeAllocator> code_alloc_;
+  std::unique_ptr<CodeAllocator> host_code_alloc_;
   std::unique_ptr<CodeStubs> code_stubs_;
 
   ke::InlineList<PluginRuntime> runtimes_;
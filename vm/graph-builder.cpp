@@ -20,13 +20,15 @@ namespace sp {
 
 using namespace ke;
 
-GraphBuilder::GraphBuilder(PluginRuntime* rt, uint32_t start_offset)
+GraphBuilder::GraphBuilder(PluginRuntime* rt, const uint8_t* code, size_t code_length,
+                           uint32_t start_offset)
  : rt_(rt),
    start_offset_(start_offset),
-   error_code_(0)
+   error_code_(0),
+   code_(code)
 {
-  start_at_ = rt_->code().bytes + start_offset_;
-  stop_at_ = rt_->code().bytes + rt_->code().length;
+  start_at_ = code_ + start_offset_;
+  stop_at_ = code_ + code_length;
 }
 
 RefPtr<ControlFlowGraph>
@@ -55,7 +57,7 @@ GraphBuilder::build()
 bool
 GraphBuilder::scan()
 {
-  graph_ = new ControlFlowGraph(rt_, start_at_);
+  graph_ = new ControlFlowGraph(rt_, code_, start_at_);
   current_ = graph_->entry();
 
   block_map_.init(16);
@@ -170,7 +172,7 @@ GraphBuilder::scanFlow() -> FlowState
     case OP_SWITCH:
     {
       cell_t target_pos = read();
-      const uint8_t* target = rt_->code().bytes + target_pos;
+      const uint8_t* target = code_ + target_pos;
       uint32_t target_cell_number = getCellNumber(target);
 
       // This will check that (a) we target a valid instruction, and (b) that
@@ -248,7 +250,7 @@ GraphBuilder::scanSwitchFlow(const uint8_t* insn) -> FlowState
 
   // Process each case.
   for (cell_t target_pos : cases) {
-    const uint8_t* target = rt_->code().bytes + target_pos;
+    const uint8_t* target = code_ + target_pos;
     if (!insn_bitmap_.test(getCellNumber(target))) {
       error(SP_ERROR_INSTRUCTION_PARAM);
       return FlowState::Error;
@@ -387,13 +389,13 @@ GraphBuilder::prescan_jump_target(OPCODE op, cell_t target)
   // Note that stop_at_ is still the end of the code section, so this is a
   // valid check. If we ever pre-fill stop_at_ with the correct value, this
   // will still be valid, just redundant.
-  if (size_t(target) >= size_t(stop_at_ - rt_->code().bytes))
+  if (size_t(target) >= size_t(stop_at_ - code_))
     return error(SP_ERROR_INSTRUCTION_PARAM);
 
   // Note that the target must not be equal to start_at_, since jumping to
   // the OP_PROC is illegal (this would push infinite stack frames or
   // something).
-  const uint8_t* cip = rt_->code().bytes + target;
+  const uint8_t* cip = code_ + target;
   if (cip <= start_at_)
     return error(SP_ERROR_INSTRUCTION_PARAM);
 
@@ -419,8 +421,14 @@ GraphBuilder::prescan_casetable(const uint8_t* pos, cell_t size)
     return false;
   pos += sizeof(cell_t);
 
+  const cell_t* prev_value = nullptr;
   while (pos < end) {
-    // Skip the value.
+    // Values must be sorted and unique, so the interpreter and JIT can search
+    // or index the table instead of scanning it.
+    const cell_t* value = reinterpret_cast<const cell_t*>(pos);
+    if (prev_value && *value <= *prev_value)
+      return error(SP_ERROR_INSTRUCTION_PARAM);
+    prev_value = value;
     pos += sizeof(cell_t);
     cell_t target = *reinterpret_cast<const uint32_t*>(pos);
     if (!prescan_jump_target(OP_JUMP, target))
@@ -34,7 +34,9 @@ class PluginRuntime;
 class GraphBuilder
 {
  public:
-  GraphBuilder(PluginRuntime* rt, uint32_t start_offset);
+  // |rt| may be null if the code does not belong to a loaded runtime.
+  GraphBuilder(PluginRuntime* rt, const uint8_t* code, size_t code_length,
+               uint32_t start_offset);
 
   ke::RefPtr<ControlFlowGraph> build();
 
@@ -101,6 +103,7 @@ class GraphBuilder
   int error_code_;
 
   // Reader state.
+  const uint8_t* code_;
   const uint8_t* start_at_;
   const uint8_t* stop_at_;
   const uint8_t* cip_;
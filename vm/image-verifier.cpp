@@ -0,0 +1,194 @@
+// vim: set sts=2 ts=8 sw=2 tw=99 et:
+//
+// Copyright (C) 2006-2015 AlliedModders LLC
+//
+// This file is part of SourcePawn. SourcePawn is free software: you can
+// redistribute it and/or modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// You should have received a copy of the GNU General Public License along with
+// SourcePawn. If not, see http://www.gnu.org/licenses/.
+//
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <amtl/am-bits.h>
+#include <amtl/am-string.h>
+#include "environment.h"
+#include "image-verifier.h"
+#include "method-verifier.h"
+#include "plugin-context.h"
+#include "smx-v1-image.h"
+
+namespace sp {
+
+using namespace ke;
+
+// Threads are not worth starting for fewer methods than this.
+static const size_t kMethodsPerThread = 32;
+
+namespace {
+
+// Verifies a batch of methods, with each thread pulling the next unclaimed
+// method from a shared cursor. Every thread keeps its own list of call
+// targets, so nothing is shared but the cursor and the first failure.
+class MethodBatch
+{
+ public:
+  MethodBatch(const VerifierInput& input, const std::vector<uint32_t>& methods)
+   : input_(input),
+     methods_(methods),
+     next_(0),
+     failed_(false),
+     failed_index_(0),
+     error_(SP_ERROR_NONE)
+  {}
+
+  bool run(unsigned int max_threads, std::vector<uint32_t>* calls) {
+    size_t num_threads = std::min(size_t(max_threads), methods_.size() / kMethodsPerThread);
+
+    // The calling thread does its share, so only start the rest.
+    std::vector<std::vector<uint32_t>> thread_calls(num_threads > 1 ? num_threads - 1 : 0);
+    std::vector<std::thread> threads;
+    for (auto& list : thread_calls)
+      threads.emplace_back([this, &list]() -> void { work(&list); });
+    work(calls);
+    for (auto& thread : threads)
+      thread.join();
+
+    for (const auto& list : thread_calls)
+      calls->insert(calls->end(), list.begin(), list.end());
+    return !failed_;
+  }
+
+  uint32_t failed_offset() const {
+    return methods_[failed_index_];
+  }
+  int error() const {
+    return error_;
+  }
+
+ private:
+  void work(std::vector<uint32_t>* calls) {
+    auto collect = [calls](cell_t offset) -> void {
+      calls->emplace_back(offset);
+    };
+
+    while (!failed_) {
+      size_t index = next_++;
+      if (index >= methods_.size())
+        return;
+
+      MethodVerifier verifier(input_, methods_[index]);
+      verifier.collectExternalFuncRefs(collect);
+      if (verifier.verify())
+        continue;
+
+      // Report the lowest failing method, so the message doesn't depend on
+      // thread timing more than it has to.
+      std::lock_guard<std::mutex> lock(lock_);
+      if (!failed_ || index < failed_index_) {
+        failed_index_ = index;
+        error_ = verifier.error();
+      }
+      failed_ = true;
+      return;
+    }
+  }
+
+ private:
+  const VerifierInput& input_;
+  const std::vector<uint32_t>& methods_;
+  std::atomic<size_t> next_;
+  std::atomic<bool> failed_;
+  std::mutex lock_;
+  size_t failed_index_;
+  int error_;
+};
+
+} // anonymous namespace
+
+static void
+DontFree(uint8_t* addr)
+{
+}
+
+bool
+VerifyImage(const uint8_t* addr, size_t length, unsigned int max_threads,
+            std::string* error)
+{
+  // The image only reads from |addr|, or decompresses it into a new buffer,
+  // so it doesn't need a copy.
+  SmxV1Image image(const_cast<uint8_t*>(addr), length, DontFree);
+  if (!image.validate()) {
+    const char* message = image.errorMessage();
+    *error = (message && *message) ? message : "binary parse error";
+    return false;
+  }
+
+  // Like PluginRuntime, verify an aligned copy if the code section isn't.
+  auto code = image.DescribeCode();
+  std::unique_ptr<uint8_t[]> aligned_code;
+  if (!IsAligned(code.bytes, sizeof(cell_t))) {
+    aligned_code = std::make_unique<uint8_t[]>(code.length);
+    memcpy(aligned_code.get(), code.bytes, code.length);
+    code.bytes = aligned_code.get();
+  }
+
+  VerifierInput input;
+  input.image = &image;
+  input.code = code.bytes;
+  input.code_length = code.length;
+  input.mem_size = PluginContext::ComputeMemorySize(image.DescribeData().length,
+                                                    image.HeapSize());
+  input.rt = nullptr;
+
+  // The method index is built lazily, and verification looks methods up from
+  // every thread, so build it now.
+  if (image.HasRtti())
+    image.GetMethodRttiByOffset(0);
+
+  if (max_threads == 0)
+    max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  // Start from the publics, then verify anything they call, until nothing new
+  // turns up. The compiler lists every function it emits as a public, so the
+  // first round usually covers everything.
+  std::unordered_set<uint32_t> seen;
+  std::vector<uint32_t> work;
+  for (size_t i = 0; i < image.NumPublics(); i++) {
+    uint32_t offset;
+    image.GetPublic(i, &offset, nullptr);
+    if (seen.emplace(offset).second)
+      work.emplace_back(offset);
+  }
+
+  while (!work.empty()) {
+    std::vector<uint32_t> calls;
+    MethodBatch batch(input, work);
+    if (!batch.run(max_threads, &calls)) {
+      const char* name = image.LookupFunction(batch.failed_offset());
+      const char* message = Environment::GetErrorString(batch.error());
+      *error = StringPrintf("Method %s failed verification: %s", name ? name : "<unknown>",
+                            message ? message : "unknown error");
+      return false;
+    }
+
+    work.clear();
+    for (uint32_t offset : calls) {
+      if (seen.emplace(offset).second)
+        work.emplace_back(offset);
+    }
+  }
+  return true;
+}
+
+} // namespace sp
@@ -0,0 +1,32 @@
+// vim: set sts=2 ts=8 sw=2 tw=99 et:
+//
+// Copyright (C) 2006-2015 AlliedModders LLC
+//
+// This file is part of SourcePawn. SourcePawn is free software: you can
+// redistribute it and/or modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// You should have received a copy of the GNU General Public License along with
+// SourcePawn. If not, see http://www.gnu.org/licenses/.
+//
+#ifndef _include_sourcepawn_vm_image_verifier_h_
+#define _include_sourcepawn_vm_image_verifier_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace sp {
+
+// Performs the same checks as loading an image and calling
+// PerformFullValidation(), but without an ISourcePawnEnvironment or a plugin
+// context. Methods are verified on up to |max_threads| threads (0 means one
+// per CPU). On failure, returns false and sets |error|.
+bool VerifyImage(const uint8_t* addr, size_t length, unsigned int max_threads,
+                 std::string* error);
+
+} // namespace sp
+
+#endif // _include_sourcepawn_vm_image_verifier_h_
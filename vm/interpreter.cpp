@@ -19,6 +19,7 @@
 #include <math.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <utility>
 
 #include "interpreter.h"
@@ -67,6 +68,8 @@ Interpreter::run()
 
   if (!cx_->pushAmxFrame())
     return false;
+  if (!consumeFuel())
+    return false;
 
   while (!has_returned_ && reader_.more()) {
     if (reader_.peekOpcode() == OP_PROC || reader_.peekOpcode() == OP_ENDPROC)
@@ -293,6 +296,15 @@ Interpreter::visitSTOR_S(cell_t offset, PawnReg src)
   return cx_->setFrameValue(offset, regs_[src]);
 }
 
+bool
+Interpreter::consumeFuel()
+{
+  if (!env_->UsesFuelMetering() || cx_->consumeFuel())
+    return true;
+  cx_->ReportErrorNumber(SP_ERROR_OUT_OF_FUEL);
+  return false;
+}
+
 bool
 Interpreter::visitJUMP(cell_t offset)
 {
@@ -302,6 +314,8 @@ Interpreter::visitJUMP(cell_t offset)
       cx_->ReportErrorNumber(SP_ERROR_TIMEOUT);
       return false;
     }
+    if (!consumeFuel())
+      return false;
   }
 
   reader_.jump(offset);
@@ -341,6 +355,10 @@ Interpreter::visitJcmp(CompareOp op, cell_t offset)
     assert(false);
   }
 
+  // Like the JIT, backward branches use fuel whether or not they're taken.
+  if (offset < reader_.cip_offset() && !consumeFuel())
+    return false;
+
   if (jump) {
     if (offset < reader_.cip_offset()) {
       // Check the watchdog timer if we're looping backwards.
@@ -657,10 +675,28 @@ Interpreter::visitFILL(uint32_t amount)
 bool
 Interpreter::visitSWITCH(cell_t defaultOffset, const CaseTableEntry* cases, size_t ncases)
 {
-  for (size_t i = 0; i < ncases; i++) {
-    if (cases[i].value == regs_.pri()) {
-      reader_.jump(cases[i].address);
-      return true;
+  // The verifier guarantees case values are sorted and unique. If there are
+  // no holes, the case table is its own jump table; otherwise, binary search.
+  // The offsets are computed unsigned so that they can't overflow.
+  cell_t value = regs_.pri();
+  if (ncases) {
+    uint32_t low = uint32_t(cases[0].value);
+    if (uint32_t(cases[ncases - 1].value) - low == ncases - 1) {
+      uint32_t index = uint32_t(value) - low;
+      if (index < ncases) {
+        reader_.jump(cases[index].address);
+        return true;
+      }
+    } else {
+      auto end = cases + ncases;
+      auto iter = std::lower_bound(cases, end, value,
+                                   [](const CaseTableEntry& entry, cell_t value) -> bool {
+        return entry.value < value;
+      });
+      if (iter != end && iter->value == value) {
+        reader_.jump(iter->address);
+        return true;
+      }
     }
   }
 
@@ -1264,6 +1300,10 @@ Interpreter::visitBREAK()
   if (!Environment::get()->IsDebugBreakEnabled())
     return true;
 
+  auto cip = reinterpret_cast<const uint8_t*>(reader_.insn_begin()) - rt_->code().bytes;
+  if (!rt_->IsDebugBreakArmed(cip))
+    return true;
+
   InvokeDebugger(cx_, nullptr);
   return !env_->hasPendingException();
 }
@@ -181,6 +181,7 @@ class Interpreter final : public PcodeVisitor
 
  private:
   bool invokeNative(uint32_t native_index);
+  bool consumeFuel();
 
  private:
   Environment* env_;
@@ -65,6 +65,7 @@ CompilerBase::Compile(PluginContext* cx, RefPtr<MethodInfo> method, int* err)
   }
 
   method->setCompiledFunction(fun);
+  cx->runtime()->UpdateDebugBreaks(fun);
   return fun;
 }
 
@@ -159,6 +160,8 @@ CompilerBase::emit()
 
   // For each backward jump, emit a little thunk so we can exit from a timeout.
   // Track the offset of where the thunk is, so the watchdog timer can patch it.
+  if (!backward_jumps_.empty())
+    debug_map.push_back({ masm.pc(), "<timeout thunks>", 0 });
   for (size_t i = 0; i < backward_jumps_.size(); i++) {
     BackwardJump& jump = backward_jumps_[i];
     jump.timeout_offset = masm.pc();
@@ -167,6 +170,7 @@ CompilerBase::emit()
   }
 
   // These have to come last.
+  debug_map.push_back({ masm.pc(), "<error stubs>", 0 });
   emitThrowPathIfNeeded(SP_ERROR_DIVIDE_BY_ZERO);
   emitThrowPathIfNeeded(SP_ERROR_STACKLOW);
   emitThrowPathIfNeeded(SP_ERROR_STACKMIN);
@@ -180,6 +184,9 @@ CompilerBase::emit()
   // Common path for invoking line debugger.
   emitDebugBreakHandler();
 
+  // Common path for refilling or reporting exhausted fuel.
+  emitFuelHandler();
+
   // This has to come very, very last, since it checks whether return paths
   // are used.
   emitErrorHandlers();
@@ -191,7 +198,7 @@ CompilerBase::emit()
   if (error_)
     return nullptr;
 
-  CodeChunk code = LinkCode(env_, masm, debug_name_.c_str(), debug_map);
+  CodeChunk code = LinkCode(env_, masm, debug_name_.c_str(), debug_map, rt_->code_allocator());
   if (!code.address()) {
     reportError(SP_ERROR_OUT_OF_MEMORY);
     return nullptr;
@@ -209,8 +216,21 @@ CompilerBase::emit()
     new FixedArray<CipMapEntry>(cip_map_.size()));
   memcpy(cipmap->buffer(), cip_map_.data(), cip_map_.size() * sizeof(CipMapEntry));
 
+  // Break sites are emitted disarmed. The runtime arms the ones it needs once
+  // the function is installed.
+  std::unique_ptr<FixedArray<DebugBreakSite>> breaks(
+    new FixedArray<DebugBreakSite>(debug_breaks_.size()));
+  for (size_t i = 0; i < debug_breaks_.size(); i++) {
+    const DebugBreak& site = debug_breaks_[i];
+    breaks->at(i).offset = site.pc;
+    breaks->at(i).disp32 = int32_t(debug_break_.offset()) - int32_t(site.pc);
+    breaks->at(i).cip = uintptr_t(site.cip) - uintptr_t(rt_->code().bytes);
+    breaks->at(i).armed = false;
+  }
+
   assert(error_ == SP_ERROR_NONE);
-  return new CompiledFunction(code, pcode_start_, edges.release(), cipmap.release());
+  return new CompiledFunction(code, pcode_start_, edges.release(), cipmap.release(),
+                              breaks.release());
 }
 
 void
@@ -295,8 +315,10 @@ CompilerBase::CompileFromThunk(PluginContext* cx, cell_t pcode_offs, void** addr
 
   *addrp = fn->GetEntryAddress();
 
-  /* Right now, we always keep the code RWE */
-  PatchCallThunk(pc, fn->GetEntryAddress());
+  // The caller's code may be mapped read+execute only, so patch it through
+  // the writable view.
+  uint8_t* writable = cx->runtime()->code_allocator()->WritableAddress(pc - 4) + 4;
+  PatchCallThunk(pc, writable, fn->GetEntryAddress());
   return SP_ERROR_NONE;
 }
 
@@ -334,6 +356,45 @@ CompilerBase::InvokeReportTimeout()
   InvokeReportError(SP_ERROR_TIMEOUT);
 }
 
+// Exit frame is a JitExitFrameForHelper. Returns 0 if execution may continue.
+int
+CompilerBase::InvokeFuelExhausted(PluginContext* cx)
+{
+  if (cx->refillFuel())
+    return 0;
+  cx->ReportErrorNumber(SP_ERROR_OUT_OF_FUEL);
+  return 1;
+}
+
+void
+CompilerBase::emitFuelPath(FuelPath* path)
+{
+  __ call(&fuel_exhausted_);
+  emitCipMapping(path->cip);
+  __ jmp(&path->resume);
+}
+
+bool
+FuelPath::emit(Compiler* cc)
+{
+  cc->emitFuelPath(this);
+  return true;
+}
+
+void
+CompilerBase::emitTimeoutPath(TimeoutPath* path)
+{
+  __ call(&throw_timeout_);
+  emitCipMapping(path->cip);
+}
+
+bool
+TimeoutPath::emit(Compiler* cc)
+{
+  cc->emitTimeoutPath(this);
+  return true;
+}
+
 bool
 ErrorPath::emit(Compiler* cc)
 {
@@ -36,6 +36,18 @@ class PluginRuntime;
 class PluginContext;
 class LegacyImage;
 
+struct DebugBreak {
+  // The pc just past the patchable site.
+  uint32_t pc;
+  // The cip of the BREAK opcode.
+  const cell_t* cip;
+
+  DebugBreak(uint32_t pc, const cell_t* cip)
+   : pc(pc),
+     cip(cip)
+  {}
+};
+
 struct BackwardJump {
   // The pc at the jump instruction (i.e. after it).
   uint32_t pc;
@@ -55,6 +67,8 @@ struct BackwardJump {
 class CompilerBase : public PcodeVisitor
 {
   friend class ErrorPath;
+  friend class TimeoutPath;
+  friend class FuelPath;
 
  public:
   CompilerBase(PluginRuntime* rt, MethodInfo* method);
@@ -74,13 +88,17 @@ class CompilerBase : public PcodeVisitor
   virtual void emitErrorHandlers() = 0;
   virtual void emitOutOfBoundsErrorPath(OutOfBoundsErrorPath* path) = 0;
   virtual void emitDebugBreakHandler() = 0;
+  virtual void emitFuelHandler() = 0;
 
   // Helpers.
   static int CompileFromThunk(PluginContext* cx, cell_t pcode_offs, void** addrp, uint8_t* pc);
   static void* find_entry_fp();
   static void InvokeReportError(int err);
   static void InvokeReportTimeout();
-  static void PatchCallThunk(uint8_t* pc, void* target);
+  static int InvokeFuelExhausted(PluginContext* cx);
+  // |pc| is the return address of the call; |writable| is the same address
+  // in the writable view of the code.
+  static void PatchCallThunk(uint8_t* pc, uint8_t* writable, void* target);
 
  protected:
   cell_t readCell();
@@ -104,6 +122,8 @@ class CompilerBase : public PcodeVisitor
 
  protected:
   void emitErrorPath(ErrorPath* path);
+  void emitTimeoutPath(TimeoutPath* path);
+  void emitFuelPath(FuelPath* path);
   void emitThrowPathIfNeeded(int err);
 
   void reportError(int err);
@@ -127,6 +147,7 @@ class CompilerBase : public PcodeVisitor
   std::vector<OutOfLinePath*> ool_paths_;
 
   Label throw_timeout_;
+  Label fuel_exhausted_;
   Label throw_error_code_[SP_MAX_ERROR_CODES];
   Label report_error_;
   Label return_reported_error_;
@@ -137,6 +158,7 @@ class CompilerBase : public PcodeVisitor
   std::string debug_name_;
 
   std::vector<BackwardJump> backward_jumps_;
+  std::vector<DebugBreak> debug_breaks_;
   std::vector<CipMapEntry> cip_map_;
 };
 
@@ -35,7 +35,10 @@ class LegacyImage
   };
   struct Data {
     const uint8_t* bytes;
+    // Size of the data section in memory.
     size_t length;
+    // Number of bytes stored at |bytes|. The rest of the section is zero.
+    size_t initialized_length;
   };
 
   // (Almost) everything needed to implement the AMX and SPVM API.
@@ -87,6 +90,7 @@ class EmptyImage : public LegacyImage
     Data out;
     out.bytes = data_;
     out.length = sizeof(data_);
+    out.initialized_length = sizeof(data_);
     return out;
   }
   size_t NumNatives() const override {
@@ -16,19 +16,20 @@
 using namespace sp;
 
 CodeChunk
-sp::LinkCode(Environment* env, Assembler& masm, const char* name, const CodeDebugMap& mapping)
+sp::LinkCode(Environment* env, Assembler& masm, const char* name, const CodeDebugMap& mapping,
+             CodeAllocator* allocator)
 {
   if (masm.outOfMemory())
     return CodeChunk();
 
   auto length = masm.length();
-  CodeChunk code = env->AllocateCode(length);
+  CodeChunk code = allocator ? allocator->Allocate(length) : env->AllocateCode(length);
 
   auto address = code.address();
   if (!address)
     return code;
 
-  masm.emitToExecutableMemory(address);
+  masm.emitToExecutableMemory(address, code.writable());
 
   env->WriteDebugMetadata(address, length, name, mapping);
 
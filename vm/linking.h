@@ -20,11 +20,16 @@
 
 namespace sp {
 
+class CodeAllocator;
 class Environment;
 struct CodeDebugMapping;
 using CodeDebugMap = std::vector<CodeDebugMapping>;
 
-CodeChunk LinkCode(Environment* env, Assembler& masm, const char* name, const CodeDebugMap& mapping);
+// Copies assembled code into executable memory and records its debug
+// metadata. Memory comes from |allocator| if given, otherwise from the
+// environment's shared pools.
+CodeChunk LinkCode(Environment* env, Assembler& masm, const char* name, const CodeDebugMap& mapping,
+                   CodeAllocator* allocator = nullptr);
 
 }
 
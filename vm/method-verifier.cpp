@@ -24,12 +24,29 @@ namespace sp {
 
 using namespace ke;
 
+static VerifierInput
+InputFromRuntime(PluginRuntime* rt)
+{
+  VerifierInput input;
+  input.image = rt->image();
+  input.code = rt->code().bytes;
+  input.code_length = rt->code().length;
+  input.mem_size = rt->context()->HeapSize();
+  input.rt = rt;
+  return input;
+}
+
 MethodVerifier::MethodVerifier(PluginRuntime* rt, uint32_t startOffset)
- : rt_(rt),
+ : MethodVerifier(InputFromRuntime(rt), startOffset)
+{
+}
+
+MethodVerifier::MethodVerifier(const VerifierInput& input, uint32_t startOffset)
+ : input_(input),
    block_(nullptr),
    startOffset_(startOffset),
-   memSize_(rt_->context()->HeapSize()),
-   datSize_(rt_->image()->DescribeData().length),
+   memSize_(input_.mem_size),
+   datSize_(input_.image->DescribeData().length),
    heapSize_(memSize_ - datSize_),
    max_stack_(0),
    code_(nullptr),
@@ -41,11 +58,10 @@ MethodVerifier::MethodVerifier(PluginRuntime* rt, uint32_t startOffset)
   assert(datSize_ < memSize_);
   assert(heapSize_ <= memSize_ - datSize_);
 
-  code_features_ = rt_->image()->DescribeCode().features;
+  code_features_ = input_.image->DescribeCode().features;
 
-  auto& code = rt_->code();
-  code_ = reinterpret_cast<const cell_t*>(code.bytes);
-  stop_at_ = reinterpret_cast<const cell_t*>(code.bytes + code.length);
+  code_ = reinterpret_cast<const cell_t*>(input_.code);
+  stop_at_ = reinterpret_cast<const cell_t*>(input_.code + input_.code_length);
 }
 
 ke::RefPtr<ControlFlowGraph>
@@ -56,7 +72,7 @@ MethodVerifier::verify()
     return nullptr;
   }
 
-  auto image = rt_->image();
+  auto image = input_.image;
   if (image->HasRtti()) {
     auto rtti = image->GetMethodRttiByOffset(startOffset_);
     if (!rtti || rtti->pcode_start != startOffset_) {
@@ -65,7 +81,7 @@ MethodVerifier::verify()
     }
   }
 
-  GraphBuilder gb(rt_, startOffset_);
+  GraphBuilder gb(input_.rt, input_.code, input_.code_length, startOffset_);
   graph_ = gb.build();
   if (!graph_) {
     reportError(gb.error_code());
@@ -474,7 +490,7 @@ MethodVerifier::verifyOp(OPCODE op)
   case OP_SYSREQ_C:
   {
     cell_t index = readCell();
-    if (index < 0 || size_t(index) >= rt_->image()->NumNatives()) {
+    if (index < 0 || size_t(index) >= input_.image->NumNatives()) {
       reportError(SP_ERROR_INSTRUCTION_PARAM);
       return false;
     }
@@ -484,7 +500,7 @@ MethodVerifier::verifyOp(OPCODE op)
   case OP_SYSREQ_N:
   {
     cell_t index = readCell();
-    if (index < 0 || size_t(index) >= rt_->image()->NumNatives()) {
+    if (index < 0 || size_t(index) >= input_.image->NumNatives()) {
       reportError(SP_ERROR_INSTRUCTION_PARAM);
       return false;
     }
@@ -22,12 +22,31 @@
 
 namespace sp {
 
+class LegacyImage;
 class PluginRuntime;
 
+// The parts of a plugin the verifier looks at. These can come from a loaded
+// runtime, or straight from an image that was never loaded.
+struct VerifierInput {
+  const LegacyImage* image;
+
+  // Cell-aligned copy of the code section.
+  const uint8_t* code;
+  size_t code_length;
+
+  // Memory a context for this image would have. See
+  // PluginContext::ComputeMemorySize().
+  size_t mem_size;
+
+  // Only needed to dump control-flow graphs. May be null.
+  PluginRuntime* rt;
+};
+
 class MethodVerifier final
 {
  public:
   explicit MethodVerifier(PluginRuntime* rt, uint32_t startOffset);
+  MethodVerifier(const VerifierInput& input, uint32_t startOffset);
 
   typedef std::function<void(cell_t)> ExternalFuncRefCallback;
   void collectExternalFuncRefs(const ExternalFuncRefCallback& callback);
@@ -98,7 +117,7 @@ class MethodVerifier final
   bool popHeap(uint32_t num_cells);
 
  private:
-  PluginRuntime* rt_;
+  VerifierInput input_;
   ke::RefPtr<ControlFlowGraph> graph_;
   Block* block_;
   std::vector<Block*> verify_joins_;
@@ -56,6 +56,36 @@ class ErrorPath : public OutOfLinePath
   int err;
 };
 
+// Taken from a loop back-edge when the watchdog has timed out, if the
+// environment uses polled interrupts.
+class TimeoutPath : public OutOfLinePath
+{
+ public:
+  explicit TimeoutPath(const cell_t* cip)
+   : cip(cip)
+  {}
+
+  bool emit(Compiler* cc) override;
+
+  const cell_t* cip;
+};
+
+// Taken when the context's fuel counter goes negative, if the environment
+// uses fuel metering. Execution resumes at |resume| if the context has no
+// budget.
+class FuelPath : public OutOfLinePath
+{
+ public:
+  explicit FuelPath(const cell_t* cip)
+   : cip(cip)
+  {}
+
+  bool emit(Compiler* cc) override;
+
+  const cell_t* cip;
+  Label resume;
+};
+
 class OutOfBoundsErrorPath : public OutOfLinePath
 {
  public:
@@ -14,6 +14,7 @@
 #include <stdarg.h>
 #include <assert.h>
 #include <limits.h>
+#include <algorithm>
 #include <sp_vm_api.h>
 #include "plugin-context.h"
 #include "watchdog_timer.h"
@@ -32,20 +33,13 @@ PluginContext::PluginContext(PluginRuntime* pRuntime)
  : m_pRuntime(pRuntime),
    memory_(nullptr),
    data_size_(m_pRuntime->data().length),
-   mem_size_(m_pRuntime->image()->HeapSize()),
+   mem_size_(ComputeMemorySize(data_size_, m_pRuntime->image()->HeapSize())),
    m_pNullVec(nullptr),
-   m_pNullString(nullptr)
+   m_pNullString(nullptr),
+   fuel_(INT32_MAX),
+   fuel_budget_(INT32_MAX),
+   fuel_limited_(false)
 {
-  // Compute and align a minimum memory amount.
-  if (mem_size_ < data_size_)
-    mem_size_ = data_size_;
-  mem_size_ = ke::Align(mem_size_, sizeof(cell_t));
-
-  // Add a minimum heap size if needed.
-  if (mem_size_ < data_size_ + kMinHeapSize)
-    mem_size_ = data_size_ + kMinHeapSize;
-  assert(ke::IsAligned(mem_size_, sizeof(cell_t)));
-
   hp_ = data_size_;
   sp_ = mem_size_ - sizeof(cell_t);
   stp_ = sp_;
@@ -53,6 +47,20 @@ PluginContext::PluginContext(PluginRuntime* pRuntime)
   hp_scope_ = -1;
 }
 
+size_t
+PluginContext::ComputeMemorySize(size_t data_size, size_t image_mem_size)
+{
+  // Compute and align a minimum memory amount.
+  size_t mem_size = std::max(image_mem_size, data_size);
+  mem_size = ke::Align(mem_size, sizeof(cell_t));
+
+  // Add a minimum heap size if needed.
+  if (mem_size < data_size + kMinHeapSize)
+    mem_size = data_size + kMinHeapSize;
+  assert(ke::IsAligned(mem_size, sizeof(cell_t)));
+  return mem_size;
+}
+
 PluginContext::~PluginContext()
 {
   delete[] memory_;
@@ -64,8 +72,11 @@ PluginContext::Initialize()
   memory_ = new uint8_t[mem_size_];
   if (!memory_)
     return false;
-  memset(memory_ + data_size_, 0, mem_size_ - data_size_);
-  memcpy(memory_, m_pRuntime->data().bytes, data_size_);
+  // Only the initialized part of the data section is stored in the image.
+  size_t initialized = m_pRuntime->data().initialized_length;
+  assert(initialized <= data_size_);
+  memcpy(memory_, m_pRuntime->data().bytes, initialized);
+  memset(memory_ + initialized, 0, mem_size_ - initialized);
 
   /* Initialize the null references */
   uint32_t index;
@@ -449,6 +460,13 @@ PluginContext::Invoke(funcid_t fnid, const cell_t* params, unsigned int num_para
   cell_t save_frm = frm_;
   cell_t save_hp_scope = hp_scope_;
 
+  // Each entry from the host starts with a full budget. Calls made by
+  // natives while the plugin is running (callbacks, forwards, and so on)
+  // draw on the remaining fuel of the outermost call, so re-entering the
+  // plugin cannot be used to escape the limit.
+  if (!IsInExec())
+    fuel_ = fuel_budget_;
+
   /* Push parameters */
   sp_ -= sizeof(cell_t) * (num_params + 1);
   cell_t* sp = (cell_t*)(memory_ + sp_);
@@ -1141,3 +1159,30 @@ IPluginFunction* PluginContext::GetFunctionByIdOrError(funcid_t func_id) {
   ReportError("Invalid function id: 0x%08x", func_id);
   return nullptr;
 }
+
+void
+PluginContext::SetFuelBudget(uint32_t units)
+{
+  fuel_limited_ = (units != 0);
+  fuel_budget_ = units ? int32_t(std::min(units, uint32_t(INT32_MAX))) : INT32_MAX;
+  fuel_ = fuel_budget_;
+}
+
+uint32_t
+PluginContext::GetFuelRemaining()
+{
+  if (!fuel_limited_)
+    return UINT32_MAX;
+  return fuel_ > 0 ? uint32_t(fuel_) : 0;
+}
+
+bool
+PluginContext::refillFuel()
+{
+  if (fuel_limited_) {
+    fuel_ = -1;
+    return false;
+  }
+  fuel_ = INT32_MAX;
+  return true;
+}
@@ -65,11 +65,17 @@ class PluginContext final : public BasePluginContext
   bool IsNullFunctionId(funcid_t func) override;
   bool GetFunctionByIdOrNull(funcid_t func, IPluginFunction** out) override;
   IPluginFunction* GetFunctionByIdOrError(funcid_t func_id) override;
+  void SetFuelBudget(uint32_t units) override;
+  uint32_t GetFuelRemaining() override;
   bool Invoke(funcid_t fnid, const cell_t* params, unsigned int num_params, cell_t* result);
 
   size_t HeapSize() const {
     return mem_size_;
   }
+
+  // Memory a context allocates for an image with the given data and memory
+  // sizes. The verifier uses this to check images that are not loaded.
+  static size_t ComputeMemorySize(size_t data_size, size_t image_mem_size);
   uint8_t* memory() const {
     return memory_;
   }
@@ -105,6 +111,9 @@ class PluginContext final : public BasePluginContext
   cell_t* addressOfHpScope() {
     return &hp_scope_;
   }
+  int32_t* addressOfFuel() {
+    return &fuel_;
+  }
 
   cell_t frm() const {
     return frm_;
@@ -116,6 +125,16 @@ class PluginContext final : public BasePluginContext
     return hp_;
   }
 
+  // Use one unit of fuel, returning false if the budget is exhausted.
+  bool consumeFuel() {
+    if (--fuel_ >= 0)
+      return true;
+    return refillFuel();
+  }
+  // Called when the fuel counter goes negative. Without a budget, the
+  // counter is reset and execution continues.
+  bool refillFuel();
+
   int popTrackerAndSetHeap();
   int pushTracker(uint32_t amount);
 
@@ -168,6 +187,11 @@ class PluginContext final : public BasePluginContext
   cell_t hp_;
   cell_t frm_;
   cell_t hp_scope_;
+
+  // Execution budget; see SetFuelBudget.
+  int32_t fuel_;
+  int32_t fuel_budget_;
+  bool fuel_limited_;
 };
 
 } // namespace sp
@@ -32,9 +32,16 @@
 using namespace sp;
 using namespace SourcePawn;
 
+// Most plugins need far less JIT code than the environment's shared pools
+// hold, so per-runtime pools start small.
+static const size_t kRuntimeMinPoolSize = 64 * 1024;
+
 PluginRuntime::PluginRuntime(LegacyImage* image)
  : image_(image),
+   code_alloc_(kRuntimeMinPoolSize, true),
    paused_(false),
+   single_step_set_(false),
+   single_step_(false),
    computed_code_hash_(false),
    computed_data_hash_(false)
 {
@@ -574,7 +581,7 @@ PluginRuntime::GetDataHash()
 {
   if (!computed_data_hash_) {
     MD5 md5_data;
-    md5_data.update((const unsigned char*)data_.bytes, data_.length);
+    md5_data.update((const unsigned char*)data_.bytes, data_.initialized_length);
     md5_data.finalize();
     md5_data.raw_digest(data_hash_);
     computed_data_hash_ = true;
@@ -706,6 +713,96 @@ PluginRuntime::UsesDirectArrays()
   return !!(features & SmxConsts::kCodeFeatureDirectArrays);
 }
 
+int
+PluginRuntime::SetBreakpoint(const char* file, uint32_t line, bool enabled)
+{
+  if (!Environment::get()->IsDebugBreakEnabled())
+    return SP_ERROR_NOTDEBUGGING;
+
+  int err;
+  ucell_t addr;
+  if ((err = LookupLineAddress(line, file, &addr)) != SP_ERROR_NONE)
+    return err;
+
+  std::lock_guard<ke::Mutex> lock(Environment::get()->lock());
+  if (enabled)
+    breakpoints_.emplace(addr);
+  else
+    breakpoints_.erase(addr);
+  UpdateAllDebugBreaks();
+  return SP_ERROR_NONE;
+}
+
+void
+PluginRuntime::SetSingleStep(bool enabled)
+{
+  std::lock_guard<ke::Mutex> lock(Environment::get()->lock());
+  single_step_set_ = true;
+  single_step_ = enabled;
+  UpdateAllDebugBreaks();
+}
+
+bool
+PluginRuntime::IsDebugBreakArmed(ucell_t cip)
+{
+  std::lock_guard<ke::Mutex> lock(Environment::get()->lock());
+  return IsDebugBreakArmedLocked(cip);
+}
+
+bool
+PluginRuntime::IsDebugBreakArmedLocked(ucell_t cip) const
+{
+  bool single_step = single_step_set_
+                     ? single_step_
+                     : Environment::get()->debugbreak() != nullptr;
+  return single_step || (!breakpoints_.empty() && breakpoints_.count(cip));
+}
+
+static void
+PatchDebugBreak(uint8_t* code, DebugBreakSite& site, bool armed)
+{
+  if (site.armed == armed)
+    return;
+
+  // Swap between "call rel32" and a 5-byte nop.
+  uint8_t* loc = code + site.offset - 5;
+  if (armed) {
+    loc[0] = 0xe8;
+    memcpy(loc + 1, &site.disp32, sizeof(site.disp32));
+  } else {
+    static const uint8_t kNop5[] = { 0x0f, 0x1f, 0x44, 0x00, 0x00 };
+    memcpy(loc, kNop5, sizeof(kNop5));
+  }
+  site.armed = armed;
+}
+
+void
+PluginRuntime::UpdateDebugBreaks(CompiledFunction* fun)
+{
+  std::lock_guard<ke::Mutex> lock(Environment::get()->lock());
+  UpdateDebugBreaksLocked(fun);
+}
+
+void
+PluginRuntime::UpdateDebugBreaksLocked(CompiledFunction* fun)
+{
+  uint8_t* base = fun->GetWritableAddress();
+  for (size_t i = 0; i < fun->NumDebugBreaks(); i++) {
+    DebugBreakSite& site = fun->GetDebugBreak(i);
+    PatchDebugBreak(base, site, IsDebugBreakArmedLocked(site.cip));
+  }
+}
+
+void
+PluginRuntime::UpdateAllDebugBreaks()
+{
+  Environment::get()->lock().AssertCurrentThreadOwns();
+  for (const auto& method : methods_) {
+    if (CompiledFunction* fun = method->jit())
+      UpdateDebugBreaksLocked(fun);
+  }
+}
+
 bool
 PluginRuntime::UsesHeapScopes()
 {
@@ -14,6 +14,7 @@
 #define _INCLUDE_SOURCEPAWN_JIT_RUNTIME_H_
 
 #include <sp_vm_api.h>
+#include <unordered_set>
 #include <amtl/am-vector.h>
 #include <amtl/am-string.h>
 #include <amtl/am-inlinelist.h>
@@ -21,6 +22,7 @@
 #include <amtl/am-refcounting.h>
 #include "scripted-invoker.h"
 #include "legacy-image.h"
+#include "code-allocator.h"
 
 namespace sp {
 
@@ -28,6 +30,7 @@ using namespace ke;
 
 class PluginContext;
 class MethodInfo;
+class CompiledFunction;
 
 struct NativeEntry : public sp_native_t
 {
@@ -91,8 +94,21 @@ class PluginRuntime
   }
   bool PerformFullValidation() override;
   bool UsesDirectArrays() override;
+  int SetBreakpoint(const char* file, uint32_t line, bool enabled) override;
+  void SetSingleStep(bool enabled) override;
   bool UsesHeapScopes();
 
+  // Whether the BREAK at |cip| should call the debug break handler.
+  bool IsDebugBreakArmed(ucell_t cip);
+
+  // Patch the break sites of a compiled function to match the current
+  // breakpoints.
+  void UpdateDebugBreaks(CompiledFunction* fun);
+
+  // Re-patch the break sites of every compiled function. The caller must hold
+  // the environment lock.
+  void UpdateAllDebugBreaks();
+
   // Mark builtin natives as bound.
   virtual void InstallBuiltinNatives();
 
@@ -137,8 +153,17 @@ class PluginRuntime
     return context_.get();
   }
 
+  // JIT code for this runtime lives in its own pools, so that unloading the
+  // plugin releases them wholesale rather than leaving holes in pools shared
+  // with other plugins.
+  CodeAllocator* code_allocator() {
+    return &code_alloc_;
+  }
+
  private:
   void SetupFloatNativeRemapping();
+  void UpdateDebugBreaksLocked(CompiledFunction* fun);
+  bool IsDebugBreakArmedLocked(ucell_t cip) const;
 
   struct floattbl_t
   {
@@ -163,6 +188,7 @@ class PluginRuntime
   std::unique_ptr<sp_pubvar_t[]> pubvars_;
   std::unique_ptr<ScriptedInvoker*[]> entrypoints_;
   std::unique_ptr<PluginContext> context_;
+  CodeAllocator code_alloc_;
 
   struct FunctionMapPolicy {
     static inline uint32_t hash(ucell_t value) {
@@ -180,6 +206,13 @@ class PluginRuntime
   // Pause state.
   bool paused_;
 
+  // Debug break state, guarded by the environment lock. Until the host calls
+  // SetSingleStep, single-stepping follows whether a debug break handler is
+  // installed at the time code is compiled or patched.
+  bool single_step_set_;
+  bool single_step_;
+  std::unordered_set<ucell_t> breakpoints_;
+
   // Checksumming.
   bool computed_code_hash_;
   bool computed_data_hash_;
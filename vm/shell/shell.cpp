@@ -13,10 +13,20 @@
 #include <sp_vm_api.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
 #include <amtl/am-cxx.h>
 #include <amtl/experimental/am-argparser.h>
 #include "environment.h"
+#include "method-info.h"
+#include "plugin-runtime.h"
 #include "stack-frames.h"
+#if defined(SP_HAS_JIT)
+# include "jit.h"
+#endif
 
 #ifdef __EMSCRIPTEN__
 # include <emscripten.h>
@@ -214,6 +224,23 @@ static cell_t DumpStackTrace(IPluginContext* cx, const cell_t* params)
   return 0;
 }
 
+// Resolve every frame like DumpStackTrace, without printing. Returns the
+// number of scripted frames.
+static cell_t WalkStack(IPluginContext* cx, const cell_t* params)
+{
+  cell_t frames = 0;
+  for (FrameIterator iter; !iter.Done(); iter.Next()) {
+    if (!iter.IsScriptedFrame())
+      continue;
+    const char* name = iter.FunctionName();
+    const char* file = iter.FilePath();
+    unsigned line = iter.LineNumber();
+    if (name && file && line)
+      frames++;
+  }
+  return frames;
+}
+
 static cell_t ReportError(IPluginContext* cx, const cell_t* params)
 {
   cx->ReportError("What the crab?!");
@@ -299,7 +326,304 @@ class DynamicNative : public INativeCallback
     uintptr_t refcount_ = 0;
 };
 
-static int Execute(const char* file)
+struct BenchOptions
+{
+  int iterations;
+  int samples;
+  // Time the JIT instead of the plugin; see BenchmarkJit.
+  bool jit;
+};
+
+struct SampleStats
+{
+  double mean;
+  double stddev;
+  double min;
+  double max;
+};
+
+static SampleStats
+Summarize(const std::vector<double>& samples)
+{
+  SampleStats stats;
+  stats.mean = 0;
+  stats.min = samples[0];
+  stats.max = samples[0];
+  for (double ns : samples) {
+    stats.mean += ns;
+    stats.min = std::min(stats.min, ns);
+    stats.max = std::max(stats.max, ns);
+  }
+  stats.mean /= samples.size();
+
+  double variance = 0;
+  for (double ns : samples)
+    variance += (ns - stats.mean) * (ns - stats.mean);
+  variance /= samples.size();
+  stats.stddev = sqrt(variance);
+  return stats;
+}
+
+// Invoke |fun| |iterations| times per sample, after one untimed warm-up
+// sample, and print the per-iteration timings as a single JSON object.
+static int
+Benchmark(const char* file, IPluginContext* cx, IPluginFunction* fun, const BenchOptions& opts)
+{
+  std::vector<double> samples;
+  for (int sample = -1; sample < opts.samples; sample++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < opts.iterations; i++) {
+      ExceptionHandler eh(cx);
+      if (!fun->Invoke()) {
+        fprintf(stderr, "Error executing %s: %s\n", fun->DebugName(), eh.Message());
+        return 1;
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (sample < 0)
+      continue;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    samples.push_back(double(ns) / opts.iterations);
+  }
+
+  SampleStats stats = Summarize(samples);
+  fprintf(stdout,
+          "{\"file\": \"%s\", \"function\": \"%s\", \"jit\": %s, \"iterations\": %d, "
+          "\"samples\": %d, \"mean_ns\": %.2f, \"stddev_ns\": %.2f, \"min_ns\": %.2f, "
+          "\"max_ns\": %.2f}\n",
+          BaseFilename(file), fun->DebugName(), sEnv->IsJitEnabled() ? "true" : "false",
+          opts.iterations, opts.samples, stats.mean, stats.stddev, stats.min, stats.max);
+  return 0;
+}
+
+#if defined(SP_HAS_JIT)
+static bool
+InvokeBench(IPluginContext* cx, IPluginFunction* fun, cell_t* result)
+{
+  ExceptionHandler eh(cx);
+  if (!fun->Invoke(result)) {
+    fprintf(stderr, "Error executing %s: %s\n", fun->DebugName(), eh.Message());
+    return false;
+  }
+  return true;
+}
+
+// Compile every public function of a fresh copy of the plugin, returning the
+// time taken per function.
+static bool
+TimeCompile(const char* file, size_t* functions, double* ns)
+{
+  char error[255];
+  std::unique_ptr<IPluginRuntime> copy(sEnv->APIv2()->LoadBinaryFromFile(file, error, sizeof(error)));
+  if (!copy) {
+    fprintf(stderr, "Could not load plugin %s: %s\n", file, error);
+    return false;
+  }
+
+  PluginRuntime* rt = PluginRuntime::FromAPI(copy.get());
+  std::vector<RefPtr<MethodInfo>> methods;
+  for (uint32_t i = 0; i < rt->GetPublicsNum(); i++) {
+    sp_public_t* pub;
+    if (rt->GetPublicByIndex(i, &pub) != SP_ERROR_NONE)
+      continue;
+    if (RefPtr<MethodInfo> method = rt->AcquireMethod(pub->code_offs))
+      methods.push_back(method);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& method : methods) {
+    int err = SP_ERROR_NONE;
+    if (!CompilerBase::Compile(rt->GetBaseContext(), method, &err)) {
+      fprintf(stderr, "Could not compile %s: %s\n", file, Environment::GetErrorString(err));
+      return false;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  *functions = methods.size();
+  *ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) /
+        std::max(methods.size(), size_t(1));
+  return true;
+}
+#endif
+
+// Time the JIT itself rather than the code it emits: compiling the plugin's
+// public functions, and the code patches made while it is loaded. Each
+// timeout patch sample swaps every loop edge to the timeout path and back,
+// and each debug break sample arms and disarms every break site (this needs
+// --validate-debug-sections). "bench" is called once before patching, so
+// that its callees are compiled and their call thunks patched, and once
+// after, to check that it still returns the same value.
+static int
+BenchmarkJit(const char* file, PluginRuntime* rt, IPluginFunction* fun, const BenchOptions& opts)
+{
+#if defined(SP_HAS_JIT)
+  if (!sEnv->IsJitEnabled()) {
+    fprintf(stderr, "--bench-jit requires the JIT\n");
+    return 1;
+  }
+
+  IPluginContext* cx = rt->GetDefaultContext();
+  cell_t expected;
+  if (!InvokeBench(cx, fun, &expected))
+    return 1;
+
+  size_t functions = 0;
+  std::vector<double> compile_samples;
+  for (int sample = -1; sample < opts.samples; sample++) {
+    double ns;
+    if (!TimeCompile(file, &functions, &ns))
+      return 1;
+    if (sample >= 0)
+      compile_samples.push_back(ns);
+  }
+
+  std::vector<double> timeout_samples;
+  for (int sample = -1; sample < opts.samples; sample++) {
+    auto start = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<ke::Mutex> lock(sEnv->lock());
+      for (int i = 0; i < opts.iterations; i++) {
+        sEnv->PatchAllJumpsForTimeout();
+        sEnv->UnpatchAllJumpsFromTimeout();
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (sample < 0)
+      continue;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    timeout_samples.push_back(double(ns) / opts.iterations);
+  }
+
+  std::vector<double> debug_break_samples;
+  for (int sample = -1; sEnv->IsDebugBreakEnabled() && sample < opts.samples; sample++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < opts.iterations; i++) {
+      rt->SetSingleStep(true);
+      rt->SetSingleStep(false);
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (sample < 0)
+      continue;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    debug_break_samples.push_back(double(ns) / opts.iterations);
+  }
+
+  cell_t result;
+  if (!InvokeBench(cx, fun, &result))
+    return 1;
+  if (result != expected) {
+    fprintf(stderr, "%s returned %d after patching, expected %d\n", fun->DebugName(), result,
+            expected);
+    return 1;
+  }
+
+  SampleStats compile = Summarize(compile_samples);
+  SampleStats timeout = Summarize(timeout_samples);
+  fprintf(stdout,
+          "{\"file\": \"%s\", \"jit\": true, \"functions\": %zu, \"iterations\": %d, "
+          "\"samples\": %d, \"compile_mean_ns\": %.2f, \"compile_min_ns\": %.2f, "
+          "\"timeout_patch_mean_ns\": %.2f, \"timeout_patch_min_ns\": %.2f",
+          BaseFilename(file), functions, opts.iterations, opts.samples, compile.mean,
+          compile.min, timeout.mean, timeout.min);
+  if (!debug_break_samples.empty()) {
+    SampleStats debug_break = Summarize(debug_break_samples);
+    fprintf(stdout, ", \"debug_break_patch_mean_ns\": %.2f, \"debug_break_patch_min_ns\": %.2f",
+            debug_break.mean, debug_break.min);
+  }
+  fprintf(stdout, "}\n");
+  return 0;
+#else
+  fprintf(stderr, "--bench-jit requires the JIT\n");
+  return 1;
+#endif
+}
+
+// JIT code is written through a separate read+write view of its pages, so no
+// mapping should ever be writable and executable at once. Returns false and
+// prints the offending mappings if one is.
+static bool
+CheckNoWritableCode()
+{
+#if defined(__linux__)
+  FILE* fp = fopen("/proc/self/maps", "rt");
+  if (!fp) {
+    fprintf(stderr, "Could not open /proc/self/maps\n");
+    return false;
+  }
+
+  // Each line is "start-end perms offset dev inode [path]", and perms is
+  // four characters, "rwxp" or similar.
+  bool ok = true;
+  bool line_start = true;
+  char buffer[512];
+  while (fgets(buffer, sizeof(buffer), fp)) {
+    bool at_start = line_start;
+    line_start = (buffer[strlen(buffer) - 1] == '\n');
+    if (!at_start)
+      continue;
+
+    const char* perms = strchr(buffer, ' ');
+    if (!perms || strlen(perms) < 5)
+      continue;
+    if (perms[2] == 'w' && perms[3] == 'x') {
+      fprintf(stderr, "Writable and executable mapping: %s%s", buffer, line_start ? "" : "\n");
+      ok = false;
+    }
+  }
+  fclose(fp);
+  return ok;
+#else
+  return true;
+#endif
+}
+
+static void PrintCodeSpaceStats(const char* when)
+{
+  CodeSpaceStats stats = sEnv->GetCodeSpaceStats();
+  fprintf(stderr, "Code space (%s): %zu pools, %zu bytes reserved, %zu used, %zu stranded\n",
+          when, stats.pools, stats.reserved_bytes, stats.used_bytes, stats.stranded_bytes);
+}
+
+static int RunPlugin(const char* file, PluginRuntime* rt, const BenchOptions* bench,
+                     bool code_stats)
+{
+  IPluginContext* cx = rt->GetDefaultContext();
+
+  if (bench) {
+    IPluginFunction* fun = rt->GetFunctionByName("bench");
+    if (!fun) {
+      fprintf(stderr, "Plugin %s has no public function named \"bench\"\n", file);
+      return 1;
+    }
+    if (bench->jit)
+      return BenchmarkJit(file, rt, fun, *bench);
+    return Benchmark(file, cx, fun, *bench);
+  }
+
+  IPluginFunction* fun = rt->GetFunctionByName("main");
+  if (!fun)
+    return 0;
+
+  cell_t result;
+  {
+    ExceptionHandler eh(cx);
+    if (!fun->Invoke(&result)) {
+      fprintf(stderr, "Error executing main: %s\n", eh.Message());
+      return 1;
+    }
+  }
+
+  if (code_stats)
+    PrintCodeSpaceStats("loaded");
+  return result;
+}
+
+static int Execute(const char* file, const BenchOptions* bench, uint32_t fuel, bool code_stats,
+                   bool check_wx)
 {
   char error[255];
   std::unique_ptr<IPluginRuntime> rtb(sEnv->APIv2()->LoadBinaryFromFile(file, error, sizeof(error)));
@@ -323,6 +647,7 @@ static int Execute(const char* file)
   BindNative(rt, "execute", DoExecute);
   BindNative(rt, "invoke", DoInvoke);
   BindNative(rt, "dump_stack_trace", DumpStackTrace);
+  BindNative(rt, "walk_stack", WalkStack);
   BindNative(rt, "report_error", ReportError);
   BindNative(rt, "Handle.~Handle", DoNothing);
   BindNative(rt, "dynamic_native", dynamic_native.get());
@@ -331,21 +656,12 @@ static int Execute(const char* file)
   BindNative(rt, "call_with_string", CallWithString);
   BindNative(rt, "assert_eq", AssertEq);
 
-  IPluginFunction* fun = rt->GetFunctionByName("main");
-  if (!fun)
-    return 0;
-
-  IPluginContext* cx = rt->GetDefaultContext();
-
-  cell_t result;
-  {
-    ExceptionHandler eh(cx);
-    if (!fun->Invoke(&result)) {
-      fprintf(stderr, "Error executing main: %s\n", eh.Message());
-      return 1;
-    }
-  }
+  rt->GetDefaultContext()->SetFuelBudget(fuel);
 
+  // Check while the plugin's code is still mapped.
+  int result = RunPlugin(file, rt, bench, code_stats);
+  if (check_wx && !CheckNoWritableCode())
+    return 1;
   return result;
 }
 
@@ -371,6 +687,26 @@ int main(int argc, char** argv)
     "w", "disable-watchdog",
     Some(false),
     "Disable the watchdog timer.");
+  ToggleOption polled_watchdog(parser,
+    nullptr, "--polled-watchdog",
+    Some(false),
+    "Poll a timeout flag at loop back-edges instead of patching them on timeout.");
+  IntOption fuel(parser,
+    nullptr, "--fuel",
+    Some(0),
+    "Limit execution to this many function calls and loop iterations (0 for no limit).");
+  ToggleOption code_stats(parser,
+    nullptr, "--code-stats",
+    Some(false),
+    "Print JIT code memory usage after running the plugin and after unloading it.");
+  ToggleOption check_wx(parser,
+    nullptr, "--check-wx",
+    Some(false),
+    "Fail if any memory is mapped writable and executable after running the plugin.");
+  IntOption watchdog_timeout(parser,
+    nullptr, "--watchdog-timeout",
+    Some(5000),
+    "Watchdog timeout in milliseconds.");
   ToggleOption enable_jitdump(parser,
     "p", "jitdump",
     Some(false),
@@ -379,6 +715,22 @@ int main(int argc, char** argv)
     "d", "validate-debug-sections",
     Some(false),
     "Validate debug sections before loading the plugin. Enables line debugging in the runtime, which might slow down execution.");
+  ToggleOption bench(parser,
+    "b", "bench",
+    Some(false),
+    "Time repeated calls to the public function \"bench\" and print the results as JSON.");
+  ToggleOption bench_jit(parser,
+    nullptr, "--bench-jit",
+    Some(false),
+    "Time JIT compilation and code patching for the plugin and print the results as JSON.");
+  IntOption bench_iterations(parser,
+    nullptr, "--bench-iterations",
+    Some(1000),
+    "Number of calls per benchmark sample.");
+  IntOption bench_samples(parser,
+    nullptr, "--bench-samples",
+    Some(10),
+    "Number of benchmark samples to take.");
   StringOption filename(parser,
     "file",
     "SMX file to execute.");
@@ -412,17 +764,34 @@ int main(int argc, char** argv)
   if (getenv("VALIDATE_DEBUG_SECTIONS") || validate_debug_sections.value())
     sEnv->EnableDebugBreak();
 
+  if (polled_watchdog.value())
+    sEnv->EnablePolledInterrupts();
+
+  if (fuel.value() > 0)
+    sEnv->EnableFuelMetering();
+
   ShellDebugListener debug;
   sEnv->SetDebugger(&debug);
 
   if (!getenv("DISABLE_WATCHDOG") && !disable_watchdog.value())
-    sEnv->InstallWatchdogTimer(5000);
+    sEnv->InstallWatchdogTimer(std::max(watchdog_timeout.value(), 1));
 
   if (enable_jitdump.value()) {
     sEnv->SetDebugMetadataFlags(JIT_DEBUG_PERF_BASIC | JIT_DEBUG_PERF_JITDUMP);
   }
 
-  int errcode = Execute(filename.value().c_str());
+  BenchOptions bench_opts;
+  bench_opts.iterations = std::max(bench_iterations.value(), 1);
+  bench_opts.samples = std::max(bench_samples.value(), 1);
+  bench_opts.jit = bench_jit.value();
+
+  bool benchmark = bench.value() || bench_jit.value();
+  int errcode = Execute(filename.value().c_str(), benchmark ? &bench_opts : nullptr,
+                        uint32_t(std::max(fuel.value(), 0)), code_stats.value(),
+                        check_wx.value());
+
+  if (code_stats.value())
+    PrintCodeSpaceStats("after unload");
 
   sEnv->SetDebugger(NULL);
   sEnv->Shutdown();
@@ -7,8 +7,10 @@
 // provided with this file, you can obtain it here:
 //   http://www.gnu.org/licenses/gpl.html
 //
+#include <algorithm>
 #include <utility>
 
+#include <amtl/am-bits.h>
 #include <amtl/am-string.h>
 #include "smx-v1-image.h"
 #include <zlib/zlib.h>
@@ -240,8 +242,19 @@ SmxV1Image::validateData()
     reinterpret_cast<const sp_file_data_t*>(buffer() + section->dataoffs);
   if (data->data > section->size)
     return error("invalid data blob");
-  if (data->datasize > (section->size - data->data))
-    return error("invalid data blob");
+
+  // Normally the whole data section is stored. With zero-filled data, only a
+  // prefix is, and the VM zeroes the rest.
+  uint32_t stored = section->size - data->data;
+  if (data->datasize <= stored) {
+    data_initialized_size_ = data->datasize;
+  } else {
+    if (!(code_.features() & SmxConsts::kCodeFeatureZeroFilledData))
+      return error("invalid data blob");
+    if (!ke::IsAligned(stored, sizeof(cell_t)))
+      return error("invalid data blob");
+    data_initialized_size_ = stored;
+  }
 
   const uint8_t* blob =
     reinterpret_cast<const uint8_t*>(data) + data->data;
@@ -281,7 +294,8 @@ SmxV1Image::validateCode()
   uint32_t supported_features =
     SmxConsts::kCodeFeatureDirectArrays |
     SmxConsts::kCodeFeatureHeapScopes |
-    SmxConsts::kCodeFeatureNullFunctions;
+    SmxConsts::kCodeFeatureNullFunctions |
+    SmxConsts::kCodeFeatureZeroFilledData;
   if (features & ~supported_features)
     return error("unsupported feature set; code is too new");
 
@@ -805,6 +819,7 @@ SmxV1Image::DescribeData() const -> Data
   Data data;
   data.bytes = data_.blob();
   data.length = data_.length();
+  data.initialized_length = data_initialized_size_;
   return data;
 }
 
@@ -948,8 +963,8 @@ SmxV1Image::LookupFile(uint32_t addr) const
 }
 
 template <typename SymbolType, typename DimType>
-const char*
-SmxV1Image::lookupFunction(const SymbolType* syms, uint32_t addr) const
+void
+SmxV1Image::indexDebugFunctions(const SymbolType* syms) const
 {
   const uint8_t* cursor = reinterpret_cast<const uint8_t*>(syms);
   const uint8_t* cursor_end = cursor + debug_symbols_section_->size;
@@ -958,45 +973,104 @@ SmxV1Image::lookupFunction(const SymbolType* syms, uint32_t addr) const
       break;
 
     const SymbolType* sym = reinterpret_cast<const SymbolType*>(cursor);
-    if (sym->ident == sp::IDENT_FUNCTION &&
-        sym->codestart <= addr &&
-        sym->codeend > addr)
-    {
-      if (sym->name >= debug_names_section_->size)
-        return nullptr;
-      return debug_names_ + sym->name;
+    if (sym->ident == sp::IDENT_FUNCTION) {
+      const char* name = nullptr;
+      if (sym->name < debug_names_section_->size)
+        name = debug_names_ + sym->name;
+      debug_functions_.push_back(FunctionRange{uint32_t(sym->codestart), uint32_t(sym->codeend),
+                                               name, nullptr});
     }
 
     if (sym->dimcount > 0)
       cursor += sizeof(DimType) * sym->dimcount;
     cursor += sizeof(SymbolType);
   }
-  return nullptr;
 }
 
-const char*
-SmxV1Image::LookupFunction(uint32_t code_offset) const
+void
+SmxV1Image::buildFunctionIndex() const
+{
+  std::call_once(function_index_once_, &SmxV1Image::indexFunctions, this);
+}
+
+void
+SmxV1Image::indexFunctions() const
 {
-  if (auto method = GetMethodRttiByOffset(code_offset))
-    return names_ + method->name;
+  auto by_start = [](const FunctionRange& a, const FunctionRange& b) -> bool {
+    return a.start < b.start;
+  };
 
-  if (debug_syms_) {
-    auto name = lookupFunction<sp_fdbg_symbol_t, sp_fdbg_arraydim_t>(debug_syms_, code_offset);
-    if (name)
-      return name;
+  if (rtti_methods_) {
+    for (uint32_t i = 0; i < rtti_methods_->row_count; i++) {
+      const smx_rtti_method* method = getRttiRow<smx_rtti_method>(rtti_methods_, i);
+      rtti_functions_.push_back(FunctionRange{method->pcode_start, method->pcode_end,
+                                              names_ + method->name, method});
+    }
+    std::stable_sort(rtti_functions_.begin(), rtti_functions_.end(), by_start);
   }
-  if (debug_syms_unpacked_) {
-    auto name =
-      lookupFunction<sp_u_fdbg_symbol_t, sp_u_fdbg_arraydim_t>(debug_syms_unpacked_, code_offset);
-    if (name)
-      return name;
+
+  if (debug_syms_)
+    indexDebugFunctions<sp_fdbg_symbol_t, sp_fdbg_arraydim_t>(debug_syms_);
+  else if (debug_syms_unpacked_)
+    indexDebugFunctions<sp_u_fdbg_symbol_t, sp_u_fdbg_arraydim_t>(debug_syms_unpacked_);
+  std::stable_sort(debug_functions_.begin(), debug_functions_.end(), by_start);
+
+  // Name lookups prefer RTTI, like LookupFunctionAddress always has. Equal
+  // names stay in address order.
+  const auto& named = rtti_methods_ ? rtti_functions_ : debug_functions_;
+  for (const auto& range : named) {
+    if (range.name)
+      functions_by_name_.push_back(&range);
   }
+  std::stable_sort(functions_by_name_.begin(), functions_by_name_.end(),
+                   [](const FunctionRange* a, const FunctionRange* b) -> bool {
+    return strcmp(a->name, b->name) < 0;
+  });
+
+  for (size_t i = 0; i < publics_.length(); i++)
+    publics_by_address_.emplace_back(publics_[i].address, names_ + publics_[i].name);
+  std::stable_sort(publics_by_address_.begin(), publics_by_address_.end(),
+                   [](const auto& a, const auto& b) -> bool {
+    return a.first < b.first;
+  });
+}
 
-  for (size_t i = 0; i < publics_.length(); i++) {
-    if (code_offset == publics_[i].address)
-      return names_ + publics_[i].name;
+const SmxV1Image::FunctionRange*
+SmxV1Image::findFunctionRange(const std::vector<FunctionRange>& ranges, uint32_t addr)
+{
+  // Find the last function starting at or before |addr|.
+  auto iter = std::upper_bound(ranges.begin(), ranges.end(), addr,
+                               [](uint32_t addr, const FunctionRange& range) -> bool {
+    return addr < range.start;
+  });
+  if (iter == ranges.begin())
+    return nullptr;
+  --iter;
+  if (iter->end <= addr)
+    return nullptr;
+  return &*iter;
+}
+
+const char*
+SmxV1Image::LookupFunction(uint32_t code_offset) const
+{
+  buildFunctionIndex();
+
+  if (auto range = findFunctionRange(rtti_functions_, code_offset))
+    return range->name;
+  if (auto range = findFunctionRange(debug_functions_, code_offset)) {
+    if (range->name)
+      return range->name;
   }
 
+  auto iter = std::lower_bound(publics_by_address_.begin(), publics_by_address_.end(),
+                               code_offset,
+                               [](const std::pair<uint32_t, const char*>& entry, uint32_t addr) -> bool {
+    return entry.first < addr;
+  });
+  if (iter != publics_by_address_.end() && iter->first == code_offset)
+    return iter->second;
+
   return nullptr;
 }
 
@@ -1012,11 +1086,10 @@ SmxV1Image::GetMethodRttiByOffset(uint32_t pcode_offset) const
   if (!rtti_methods_)
     return nullptr;
 
-  for (uint32_t i = 0; i < rtti_methods_->row_count; i++) {
-    const smx_rtti_method* method = getRttiRow<smx_rtti_method>(rtti_methods_, i);
-    if (method->pcode_start <= pcode_offset && method->pcode_end > pcode_offset)
-      return method;
-  }
+  buildFunctionIndex();
+
+  if (auto range = findFunctionRange(rtti_functions_, pcode_offset))
+    return range->rtti;
   return nullptr;
 }
 
@@ -1060,76 +1133,54 @@ SmxV1Image::GetFileName(size_t index) const
   return debug_names_ + debug_files_[index].name;
 }
 
-template <typename SymbolType, typename DimType>
-bool
-SmxV1Image::getFunctionAddress(const SymbolType* syms, const char* function, ucell_t* funcaddr, uint32_t& index) const
+// Return the index of the first line entry at or after |addr|.
+uint32_t
+SmxV1Image::findFirstLine(uint32_t addr) const
 {
-  const uint8_t* cursor = reinterpret_cast<const uint8_t *>(syms);
-  const uint8_t* cursor_end = cursor + debug_symbols_section_->size;
-  for (uint32_t i = index; i < debug_info_->num_syms; i++) {
-    if (cursor + sizeof(SymbolType) > cursor_end)
-      break;
-
-    const SymbolType *sym = reinterpret_cast<const SymbolType *>(cursor);
-    if (sym->ident == sp::IDENT_FUNCTION &&
-        sym->name < debug_names_section_->size &&
-        !strcmp(debug_names_ + sym->name, function))
-    {
-      *funcaddr = sym->addr;
-      return true;
-    }
-
-    if (sym->dimcount > 0)
-      cursor += sizeof(DimType) * sym->dimcount;
-    cursor += sizeof(SymbolType);
+  uint32_t low = 0;
+  uint32_t high = debug_lines_.length();
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (debug_lines_[mid].addr < addr)
+      low = mid + 1;
+    else
+      high = mid;
   }
-  return false;
+  return low;
 }
 
 bool
 SmxV1Image::LookupFunctionAddress(const char* function, const char* file, ucell_t* funcaddr) const
 {
   *funcaddr = 0;
-  if (rtti_methods_) {
-    for (uint32_t i = 0; i < rtti_methods_->row_count; i++) {
-      const smx_rtti_method* method = getRttiRow<smx_rtti_method>(rtti_methods_, i);
-      const char* name = names_ + method->name;
-      if (strcmp(name, function) != 0)
-        continue;
-
-      *funcaddr = method->pcode_start;
-      // verify that this function is defined in the appropriate file
-      const char* tgtfile = LookupFile(*funcaddr);
-      if (tgtfile != nullptr && !strcmp(file, tgtfile))
-        break;
-    }
-  } else {
-    for (;;) {
-      // find (next) matching function
-      uint32_t index = 0;
-      if (debug_syms_) {
-        getFunctionAddress<sp_fdbg_symbol_t, sp_fdbg_arraydim_t>(debug_syms_, function, funcaddr, index);
-      } else {
-        getFunctionAddress<sp_u_fdbg_symbol_t, sp_u_fdbg_arraydim_t>(debug_syms_unpacked_, function, funcaddr, index);
-      }
 
-      if (index >= debug_info_->num_syms)
-        return false;
-
-      // verify that this function is defined in the appropriate file
-      const char* tgtfile = LookupFile(*funcaddr);
-      if (tgtfile != nullptr && strcmp(file, tgtfile) == 0)
-        break;
-      index++;
-      assert(index < debug_info_->num_syms);
+  buildFunctionIndex();
+
+  auto iter = std::lower_bound(functions_by_name_.begin(), functions_by_name_.end(), function,
+                               [](const FunctionRange* range, const char* name) -> bool {
+    return strcmp(range->name, name) < 0;
+  });
+
+  bool found = false;
+  for (; iter != functions_by_name_.end() && strcmp((*iter)->name, function) == 0; iter++) {
+    // With RTTI, fall back to the last function of that name if none is
+    // defined in |file|.
+    if (rtti_methods_)
+      *funcaddr = (*iter)->start;
+
+    // verify that this function is defined in the appropriate file
+    const char* tgtfile = LookupFile((*iter)->start);
+    if (tgtfile != nullptr && strcmp(file, tgtfile) == 0) {
+      *funcaddr = (*iter)->start;
+      found = true;
+      break;
     }
   }
+  if (!found && !rtti_methods_)
+    return false;
 
   // now find the first line in the function where we can "break" on
-  uint32_t index = 0;
-  for (; index < debug_info_->num_lines && debug_lines_[index].addr < *funcaddr; index++)
-    continue;
-
+  uint32_t index = findFirstLine(*funcaddr);
   if (index >= debug_info_->num_lines)
     return false;
 
@@ -1164,8 +1215,7 @@ SmxV1Image::LookupLineAddress(const uint32_t line, const char* filename, ucell_t
     topaddr = (file + 1 < debug_info_->num_files) ? debug_files_[file + 1].addr : (uint32_t)-1;
 
     // go to the starting address in the line table
-    while (index < debug_info_->num_lines && debug_lines_[index].addr < bottomaddr)
-      index++;
+    index = std::max(index, findFirstLine(bottomaddr));
 
     // browse until the line is found or until the top address is exceeded
     while (index < debug_info_->num_lines &&
@@ -23,6 +23,8 @@
 #include "rtti.h"
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace sp {
 
@@ -216,10 +218,21 @@ class SmxV1Image
   bool validateTags();
 
  private:
+  // A function's code range, used to index debug lookups.
+  struct FunctionRange {
+    uint32_t start;
+    uint32_t end;
+    const char* name;
+    const smx_rtti_method* rtti;
+  };
+
+  void buildFunctionIndex() const;
+  void indexFunctions() const;
   template <typename SymbolType, typename DimType>
-  const char* lookupFunction(const SymbolType* syms, uint32_t addr) const;
-  template <typename SymbolType, typename DimType>
-  bool getFunctionAddress(const SymbolType* syms, const char* function, ucell_t* funcaddr, uint32_t& index) const;
+  void indexDebugFunctions(const SymbolType* syms) const;
+  static const FunctionRange* findFunctionRange(const std::vector<FunctionRange>& ranges,
+                                                uint32_t addr);
+  uint32_t findFirstLine(uint32_t addr) const;
 
   const smx_rtti_table_header* findRttiSection(const char* name) const {
     const Section* section = findSection(name);
@@ -250,6 +263,7 @@ class SmxV1Image
 
   Blob<sp_file_code_t> code_;
   Blob<sp_file_data_t> data_;
+  uint32_t data_initialized_size_ = 0;
   List<sp_file_publics_t> publics_;
   List<sp_file_natives_t> natives_;
   List<sp_file_pubvars_t> pubvars_;
@@ -277,6 +291,15 @@ class SmxV1Image
   const smx_rtti_table_header* rtti_dbg_globals_ = nullptr;
   const smx_rtti_table_header* rtti_dbg_methods_ = nullptr;
   const smx_rtti_table_header* rtti_dbg_locals_ = nullptr;
+
+  // Built on the first debug lookup, which may come from any thread. Ranges
+  // are sorted by start address, and names point into whichever range list
+  // answers name lookups.
+  mutable std::once_flag function_index_once_;
+  mutable std::vector<FunctionRange> rtti_functions_;
+  mutable std::vector<FunctionRange> debug_functions_;
+  mutable std::vector<const FunctionRange*> functions_by_name_;
+  mutable std::vector<std::pair<uint32_t, const char*>> publics_by_address_;
 };
 
 } // namespace sp
@@ -350,3 +350,127 @@ FrameIterator::IsInternalFrame() const
 {
   return frame_cursor_->type() == FrameType::Internal;
 }
+
+template <typename T>
+static void
+CaptureInlineFrames(PluginContext* cx, T& iter, CapturedFrame* frames, size_t max_frames,
+                    size_t* count)
+{
+  for (;;) {
+    if (*count < max_frames) {
+      CapturedFrame& frame = frames[*count];
+      frame.cx = cx;
+      frame.type = iter.type();
+      frame.function_cip = 0;
+      frame.cip = kInvalidCip;
+      frame.native_index = 0;
+      if (frame.type == FrameType::Scripted) {
+        frame.function_cip = iter.function_cip();
+        frame.cip = iter.cip();
+      } else if (frame.type == FrameType::Native) {
+        frame.native_index = iter.native_index();
+      }
+    }
+    (*count)++;
+
+    if (iter.done())
+      break;
+    iter.next();
+  }
+}
+
+// This visits frames in the same order as FrameIterator, but the per-invoke
+// cursors live on the stack rather than the heap.
+size_t
+sp::CaptureStackTrace(CapturedFrame* frames, size_t max_frames)
+{
+  Environment* env = Environment::get();
+  intptr_t* next_exit_fp = env->exit_fp();
+
+  size_t count = 0;
+  for (InvokeFrame* ivk = env->top(); ivk; ivk = ivk->prev()) {
+    PluginContext* cx = ivk->cx();
+    if (JitInvokeFrame* jvk = ivk->AsJitInvokeFrame()) {
+      JitFrameIterator iter(cx->runtime(), next_exit_fp);
+      CaptureInlineFrames(cx, iter, frames, max_frames, &count);
+      next_exit_fp = jvk->prev_exit_fp();
+    } else if (InterpInvokeFrame* interp = ivk->AsInterpInvokeFrame()) {
+      InterpFrameIterator iter(interp);
+      CaptureInlineFrames(cx, iter, frames, max_frames, &count);
+    }
+  }
+  return count;
+}
+
+CapturedFrameIterator::CapturedFrameIterator(const CapturedFrame* frames, size_t count)
+ : frames_(frames),
+   count_(count),
+   index_(0)
+{
+}
+
+bool
+CapturedFrameIterator::IsNativeFrame() const
+{
+  return current().type == FrameType::Native;
+}
+
+bool
+CapturedFrameIterator::IsScriptedFrame() const
+{
+  return current().type == FrameType::Scripted;
+}
+
+bool
+CapturedFrameIterator::IsInternalFrame() const
+{
+  return current().type == FrameType::Internal;
+}
+
+IPluginContext*
+CapturedFrameIterator::Context() const
+{
+  return current().cx;
+}
+
+unsigned
+CapturedFrameIterator::LineNumber() const
+{
+  const CapturedFrame& frame = current();
+  if (frame.type != FrameType::Scripted || frame.cip == kInvalidCip)
+    return 0;
+
+  uint32_t line;
+  if (!frame.cx->runtime()->image()->LookupLine(frame.cip, &line))
+    return 0;
+  return line;
+}
+
+const char*
+CapturedFrameIterator::FilePath() const
+{
+  const CapturedFrame& frame = current();
+  if (frame.type != FrameType::Scripted)
+    return nullptr;
+
+  LegacyImage* image = frame.cx->runtime()->image();
+  if (frame.cip == kInvalidCip)
+    return image->LookupFile(frame.function_cip);
+  return image->LookupFile(frame.cip);
+}
+
+const char*
+CapturedFrameIterator::FunctionName() const
+{
+  const CapturedFrame& frame = current();
+  PluginRuntime* runtime = frame.cx->runtime();
+  if (frame.type == FrameType::Native) {
+    const sp_native_t* native = runtime->GetNative(frame.native_index);
+    if (!native)
+      return nullptr;
+    return native->name;
+  }
+  if (frame.type == FrameType::Scripted)
+    return runtime->image()->LookupFunction(frame.function_cip);
+  return nullptr;
+}
@@ -245,6 +245,59 @@ class FrameIterator : public SourcePawn::IFrameIterator
   std::unique_ptr<InlineFrameIterator> frame_cursor_;
 };
 
+// A frame recorded by CaptureStackTrace(). Only raw positions are kept;
+// names, files and lines are looked up when a CapturedFrameIterator is asked
+// for them. The context must outlive the captured frame.
+struct CapturedFrame
+{
+  PluginContext* cx;
+  FrameType type;
+  cell_t function_cip;
+  ucell_t cip;
+  uint32_t native_index;
+};
+
+// Record the current call stack into |frames| in a single pass, without
+// allocating. Returns the number of frames on the stack, which may be more
+// than |max_frames|; only the first |max_frames| are stored.
+size_t CaptureStackTrace(CapturedFrame* frames, size_t max_frames);
+
+// Iterates over frames from CaptureStackTrace(), symbolizing on demand.
+class CapturedFrameIterator : public SourcePawn::IFrameIterator
+{
+ public:
+  CapturedFrameIterator(const CapturedFrame* frames, size_t count);
+
+  bool Done() const override {
+    return index_ >= count_;
+  }
+  void Next() override {
+    index_++;
+  }
+  void Reset() override {
+    index_ = 0;
+  }
+
+  bool IsNativeFrame() const override;
+  bool IsScriptedFrame() const override;
+  const char* FunctionName() const override;
+  const char* FilePath() const override;
+  unsigned LineNumber() const override;
+  IPluginContext* Context() const override;
+  bool IsInternalFrame() const override;
+
+ private:
+  const CapturedFrame& current() const {
+    assert(index_ < count_);
+    return frames_[index_];
+  }
+
+ private:
+  const CapturedFrame* frames_;
+  size_t count_;
+  size_t index_;
+};
+
 } // namespace sp
 
 #endif // _include_sourcepawn_vm_stack_frames_h_
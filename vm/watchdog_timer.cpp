@@ -123,13 +123,15 @@ WatchdogTimer::Run()
 
       // Set the timeout notification bit. If this is detected before any patched
       // JIT backedges are reached, the main thread will attempt to acquire the
-      // monitor lock, and block until we call Wait().
+      // monitor lock, and block until we call Wait(). With polled interrupts,
+      // JIT backedges check this bit directly and nothing needs patching.
       timedout_ = true;
     
       // Patch all jumps. This can race with the main thread's execution since
       // all code writes are 32-bit integer instruction operands, which are
       // guaranteed to be atomic on x86.
-      env_->PatchAllJumpsForTimeout();
+      if (!env_->UsesPolledInterrupts())
+        env_->PatchAllJumpsForTimeout();
     }
 
     // The JIT will be free to compile new functions while we wait, but it will
@@ -154,7 +156,7 @@ WatchdogTimer::NotifyTimeoutReceived()
   // We are guaranteed that the watchdog thread is waiting for our
   // notification, and is therefore blocked. We take the JIT lock
   // anyway for sanity.
-  {
+  if (!env_->UsesPolledInterrupts()) {
     std::lock_guard<ke::Mutex> lock(env_->lock());
     env_->UnpatchAllJumpsFromTimeout();
   }
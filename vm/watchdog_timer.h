@@ -50,6 +50,11 @@ class WatchdogTimer
   bool NotifyTimeoutReceived();
   bool HandleInterrupt();
 
+  // Polled by JIT code when the environment uses polled interrupts.
+  const bool* addressOfTimedOut() const {
+    return &timedout_;
+  }
+
  private:
   // Watchdog thread.
   void Run();
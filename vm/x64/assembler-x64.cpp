@@ -16,19 +16,20 @@
 namespace sp {
 
 void
-Assembler::emitToExecutableMemory(void* code)
+Assembler::emitToExecutableMemory(void* code, void* writable)
 {
   assert(!outOfMemory());
 
   uint8_t* base = reinterpret_cast<uint8_t*>(code);
-  memcpy(base, buffer(), length());
+  uint8_t* out = reinterpret_cast<uint8_t*>(writable);
+  memcpy(out, buffer(), length());
 
   for (size_t i = 0; i < absolute_code_refs_.size(); i++) {
     size_t offset = absolute_code_refs_[i];
-    size_t target = *reinterpret_cast<uint64_t*>(base + offset - 8);
+    size_t target = *reinterpret_cast<uint64_t*>(out + offset - 8);
     assert(target <= length());
 
-    *reinterpret_cast<void**>(base + offset - 8) = base + target;
+    *reinterpret_cast<void**>(out + offset - 8) = base + target;
   }
 }
 
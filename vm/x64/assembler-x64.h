@@ -333,7 +333,10 @@ struct Operand
 class Assembler : public AssemblerBase
 {
  public:
-  void emitToExecutableMemory(void* code);
+  void emitToExecutableMemory(void* code) {
+    emitToExecutableMemory(code, code);
+  }
+  void emitToExecutableMemory(void* code, void* writable);
 
   void bind(Label* target) {
     if (outOfMemory()) {
@@ -825,6 +825,13 @@ class Assembler : public AssemblerBase
     emit2(0x0f, 0xa2);
   }
 
+  // nopl 0x0(%eax,%eax,1); the same size as a call rel32.
+  void nop5() {
+    emit3(0x0f, 0x1f, 0x44);
+    *pos_++ = 0x00;
+    *pos_++ = 0x00;
+  }
+
 
   // SSE operations can only be used if the feature detection function has
   // been run *and* detected the appropriate level of functionality.
@@ -900,14 +907,22 @@ class Assembler : public AssemblerBase
   }
 
   void emitToExecutableMemory(void* code) {
+    emitToExecutableMemory(code, code);
+  }
+
+  // Copy the code to |writable|, relocated to run at |code|. These differ if
+  // the code memory is dual-mapped.
+  void emitToExecutableMemory(void* code, void* writable) {
     assert(!outOfMemory());
 
     // Relocate anything we emitted as rel32 with an external pointer.
     uint8_t* base = reinterpret_cast<uint8_t*>(code);
-    memcpy(base, buffer(), length());
+    uint8_t* out = reinterpret_cast<uint8_t*>(writable);
+    memcpy(out, buffer(), length());
     for (size_t i = 0; i < external_refs_.size(); i++) {
       size_t offset = external_refs_[i];
-      PatchRel32Absolute(base + offset, *reinterpret_cast<void**>(base + offset - 4));
+      void* target = *reinterpret_cast<void**>(out + offset - 4);
+      *reinterpret_cast<int32_t*>(out + offset - 4) = uint32_t(target) - uint32_t(base + offset);
     }
 
     // Relocate everything we emitted as an abs32 with an internal offset. Note
@@ -915,8 +930,8 @@ class Assembler : public AssemblerBase
     // and CodeLabel.
     for (size_t i = 0; i < local_refs_.size(); i++) {
       size_t offset = local_refs_[i];
-      int32_t delta = *reinterpret_cast<int32_t*>(base + offset - 4);
-      *reinterpret_cast<void**>(base + offset - 4) = base + offset + delta;
+      int32_t delta = *reinterpret_cast<int32_t*>(out + offset - 4);
+      *reinterpret_cast<void**>(out + offset - 4) = base + offset + delta;
     }
   }
 
@@ -98,7 +98,15 @@ CodeStubs::CompileInvokeStub()
   __ bind(&error);
   __ jmp(&ret);
 
-  invoke_stub_ = LinkCode(env_, masm, "<jit invoke stub>", {});
+  // Name the return stub separately so profiles can tell it apart from the
+  // invoke stub. The trailing entry is dropped by perf.
+  CodeDebugMap debug_map = {
+    { 0, "<jit invoke stub>", 0 },
+    { error.offset(), "<jit return stub>", 0 },
+    { masm.length(), "<end>", 0 },
+  };
+
+  invoke_stub_ = LinkCode(env_, masm, "<jit invoke stub>", debug_map);
   if (!invoke_stub_.address())
     return false;
 
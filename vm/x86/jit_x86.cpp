@@ -49,6 +49,14 @@
 
 namespace sp {
 
+// Switches use a jump table if it spans at most this many entries, and at
+// least one in kJumpTableSlotsPerCase entries is a real case. Anything else
+// is a binary search, which ends in a compare chain once this few cases are
+// left.
+static const uint32_t kMaxJumpTableSize = 4096;
+static const size_t kJumpTableSlotsPerCase = 4;
+static const size_t kMaxLinearCases = 4;
+
 static inline ConditionCode
 OpToCondition(CompareOp op)
 {
@@ -259,6 +267,12 @@ Compiler::emitPrologue()
     __ cmpl(ecx, eax);
     jumpOnError(below, SP_ERROR_STACKLOW);
   }
+
+  // Every call uses one unit of fuel.
+  if (env_->UsesFuelMetering()) {
+    auto entry = reinterpret_cast<const uint8_t*>(code_start_) + pcode_start_;
+    emitFuelCheck(reinterpret_cast<const cell_t*>(entry));
+  }
 }
 
 bool
@@ -549,6 +563,7 @@ bool
 Compiler::visitLIDX()
 {
   __ lea(pri, Operand(alt, pri, ScaleFour));
+  emitCheckAddress(pri);
   __ movl(pri, Operand(dat, pri, NoScale));
   return true;
 }
@@ -1126,8 +1141,15 @@ Compiler::visitJUMP(cell_t offset)
 
   Label* target = successor->label();
   if (isBackedge(successor)) {
-    __ jmp32(target);
-    backward_jumps_.push_back(BackwardJump(masm.pc(), op_cip_));
+    if (env_->UsesFuelMetering())
+      emitFuelCheck(op_cip_);
+    if (env_->UsesPolledInterrupts()) {
+      emitInterruptCheck();
+      __ jmp(target);
+    } else {
+      __ jmp32(target);
+      backward_jumps_.push_back(BackwardJump(masm.pc(), op_cip_));
+    }
   } else {
     __ jmp(target);
   }
@@ -1137,6 +1159,15 @@ Compiler::visitJUMP(cell_t offset)
 bool
 Compiler::visitJcmp(CompareOp op, cell_t offset)
 {
+  // The interrupt and fuel checks clobber flags, so they must come before the
+  // compare. Fuel is used whether or not the branch is taken.
+  bool backedge = isBackedge(block_->successors()[1]);
+  if (backedge && env_->UsesFuelMetering())
+    emitFuelCheck(op_cip_);
+  bool polled_backedge = backedge && env_->UsesPolledInterrupts();
+  if (polled_backedge)
+    emitInterruptCheck();
+
   ConditionCode cc;
   switch (op) {
     case CompareOp::Zero:
@@ -1165,8 +1196,12 @@ Compiler::visitJcmp(CompareOp op, cell_t offset)
   assert(!isBackedge(fallthrough));
 
   if (isBackedge(target)) {
-    __ j32(cc, target->label());
-    backward_jumps_.push_back(BackwardJump(masm.pc(), op_cip_));
+    if (polled_backedge) {
+      __ j(cc, target->label());
+    } else {
+      __ j32(cc, target->label());
+      backward_jumps_.push_back(BackwardJump(masm.pc(), op_cip_));
+    }
 
     if (!isNextBlock(fallthrough))
       __ jmp(fallthrough->label());
@@ -1282,7 +1317,10 @@ Compiler::visitBREAK()
   if (!Environment::get()->IsDebugBreakEnabled())
     return true;
 
-  __ call(&debug_break_);
+  // Emit a nop the size of a call, which the runtime patches into a call to
+  // the debug break handler when a breakpoint or single-stepping is armed.
+  __ nop5();
+  debug_breaks_.push_back(DebugBreak(masm.pc(), op_cip_));
   emitCipMapping(op_cip_);
   return true;
 }
@@ -1602,62 +1640,74 @@ Compiler::visitSWITCH(cell_t defaultOffset,
     return true;
   }
 
-  // We have two or more cases, so let's generate a full switch. Decide
-  // whether we'll make an if chain, or a jump table, based on whether
-  // the numbers are strictly sequential.
-  bool sequential = true;
-  {
-    cell_t first = cases[0].value;
-    cell_t last = first;
-    for (size_t i = 1; i < ncases; i++) {
-      if (cases[i].value != ++last) {
-        sequential = false;
-        break;
-      }
-    }
+  // We have two or more cases, so let's generate a full switch. The verifier
+  // guarantees case values are sorted and unique. If they fill enough of
+  // their range, use a jump table with holes going to the default case.
+  // Otherwise, binary search. The range is computed unsigned so that it can't
+  // overflow.
+  uint32_t low = uint32_t(cases[0].value);
+  uint32_t range = uint32_t(cases[ncases - 1].value) - low;
+  if (range >= kMaxJumpTableSize || size_t(range) + 1 > ncases * kJumpTableSlotsPerCase) {
+    emitCaseSearch(cases, 0, ncases);
+    return true;
   }
 
-  // First check whether the bounds are correct: if (a < LOW || a > HIGH);
-  // this check is valid whether or not we emit a sequential-optimized switch.
-  cell_t low = cases[0].value;
-  if (low != 0) {
-    // negate it so we'll get a lower bound of 0.
-    low = -low;
-    __ lea(tmp, Operand(pri, low));
-  } else {
+  // Bounds check: if (unsigned(a - LOW) > HIGH - LOW) goto default.
+  if (low != 0)
+    __ lea(tmp, Operand(pri, cell_t(0 - low)));
+  else
     __ movl(tmp, pri);
-  }
-
-  cell_t high = abs(cases[0].value - cases[ncases - 1].value);
-  __ cmpl(tmp, high);
+  __ cmpl(tmp, cell_t(range));
   __ j(above, defaultCase->label());
 
-  if (sequential) {
-    // Optimized table version. The tomfoolery below is because we only have
-    // one free register... it seems unlikely pri or alt will be used given
-    // that we're at the end of a control-flow point, but we'll play it safe.
-    CodeLabel table;
-    __ push(eax);
-    __ movl(eax, &table);
-    __ movl(ecx, Operand(eax, ecx, ScaleFour));
-    __ pop(eax);
-    __ jmp(ecx);
-
-    __ bind(&table);
-    for (size_t i = 0; i < ncases; i++) {
-      Block* target = block_->successors()[i + 1];
-      __ emit_absolute_address(target->label());
+  // The tomfoolery below is because we only have one free register... it
+  // seems unlikely pri or alt will be used given that we're at the end of a
+  // control-flow point, but we'll play it safe.
+  CodeLabel table;
+  __ push(eax);
+  __ movl(eax, &table);
+  __ movl(ecx, Operand(eax, ecx, ScaleFour));
+  __ pop(eax);
+  __ jmp(ecx);
+
+  __ bind(&table);
+  size_t next = 0;
+  for (uint32_t slot = 0; slot <= range; slot++) {
+    if (uint32_t(cases[next].value) - low == slot) {
+      __ emit_absolute_address(block_->successors()[next + 1]->label());
+      next++;
+    } else {
+      __ emit_absolute_address(defaultCase->label());
     }
-  } else {
-    // Slower version. Go through each case and generate a check.
-    for (size_t i = 0; i < ncases; i++) {
-      Block* target = block_->successors()[i + 1];
+  }
+  assert(next == ncases);
+  return true;
+}
+
+// Emits a binary search over the sorted cases in [begin, end).
+void
+Compiler::emitCaseSearch(const CaseTableEntry* cases, size_t begin, size_t end)
+{
+  Block* defaultCase = block_->successors()[0];
+
+  if (end - begin <= kMaxLinearCases) {
+    for (size_t i = begin; i < end; i++) {
       __ cmpl(pri, cases[i].value);
-      __ j(equal, target->label());
+      __ j(equal, block_->successors()[i + 1]->label());
     }
     __ jmp(defaultCase->label());
+    return;
   }
-  return true;
+
+  size_t mid = begin + (end - begin) / 2;
+
+  Label upper_half;
+  __ cmpl(pri, cases[mid].value);
+  __ j(equal, block_->successors()[mid + 1]->label());
+  __ j(greater, &upper_half);
+  emitCaseSearch(cases, begin, mid);
+  __ bind(&upper_half);
+  emitCaseSearch(cases, mid + 1, end);
 }
 
 bool
@@ -1838,6 +1888,62 @@ Compiler::emitThrowPath(int err)
   __ jmp(&report_error_);
 }
 
+// With polled interrupts, back-edges test the watchdog's timeout flag instead
+// of being patched when it fires.
+void
+Compiler::emitInterruptCheck()
+{
+  TimeoutPath* path = new TimeoutPath(op_cip_);
+  ool_paths_.push_back(path);
+
+  __ cmpb(Operand(ExternalAddress((void*)env_->watchdog()->addressOfTimedOut())), 0);
+  __ j(not_equal, path->label());
+}
+
+// With fuel metering, function entries and back-edges decrement the context's
+// fuel counter, and only call out once it goes negative.
+void
+Compiler::emitFuelCheck(const cell_t* cip)
+{
+  FuelPath* path = new FuelPath(cip);
+  ool_paths_.push_back(path);
+
+  __ subl(Operand(ExternalAddress((void*)context_->addressOfFuel())), 1);
+  __ j(negative, path->label());
+  __ bind(&path->resume);
+}
+
+void
+Compiler::emitFuelHandler()
+{
+  if (!fuel_exhausted_.used())
+    return;
+
+  __ bind(&fuel_exhausted_);
+
+  // Enter the exit frame. This aligns the stack.
+  __ enterExitFrame(ExitFrameType::Helper, 0);
+
+  // Reserve space for the context and for pri and alt, which are live at
+  // conditional back-edges.
+  static const size_t kStackNeeded = 3 * sizeof(void *);
+  static const size_t kStackReserve = ke::Align(kStackNeeded, 16);
+  __ subl(esp, kStackReserve);
+  __ movl(Operand(esp, 1 * sizeof(void *)), pri);
+  __ movl(Operand(esp, 2 * sizeof(void *)), alt);
+  __ movl(Operand(esp, 0 * sizeof(void *)), intptr_t(context_));
+  __ call(ExternalAddress((void *)InvokeFuelExhausted));
+  __ movl(tmp, eax);
+  __ movl(pri, Operand(esp, 1 * sizeof(void *)));
+  __ movl(alt, Operand(esp, 2 * sizeof(void *)));
+  __ leaveExitFrame();
+
+  // The error has already been reported if we ran out.
+  __ testl(tmp, tmp);
+  __ j(not_zero, &return_reported_error_);
+  __ ret();
+}
+
 void
 Compiler::emitDebugBreakHandler()
 {
@@ -1868,9 +1974,9 @@ Compiler::emitDebugBreakHandler()
 }
 
 void
-CompilerBase::PatchCallThunk(uint8_t* pc, void* target)
+CompilerBase::PatchCallThunk(uint8_t* pc, uint8_t* writable, void* target)
 {
-  *(intptr_t*)(pc - 4) = intptr_t(target) - intptr_t(pc);
+  *(intptr_t*)(writable - 4) = intptr_t(target) - intptr_t(pc);
 }
 
 } // namespace sp
@@ -167,12 +167,16 @@ class Compiler : public CompilerBase
   void emitErrorHandlers() override;
   void emitOutOfBoundsErrorPath(OutOfBoundsErrorPath* path) override;
   void emitDebugBreakHandler() override;
+  void emitFuelHandler() override;
 
   void emitLegacyNativeCall(uint32_t native_index, NativeEntry* native);
   void emitGenArray(bool autozero);
   void emitCheckAddress(Register reg);
   void emitFloatCmp(ConditionCode cc);
+  void emitCaseSearch(const CaseTableEntry* cases, size_t begin, size_t end);
   void emitCallThunk(CallThunk* thunk);
+  void emitInterruptCheck();
+  void emitFuelCheck(const cell_t* cip);
   void jumpOnError(ConditionCode cc, int err = 0);
 
   ExternalAddress hpAddr() {